@@ -0,0 +1,481 @@
+// Benchmark of quad and BSP tree construction and traversal.
+// -------------------------------------------------------------------
+// Copyright (C) 2007 OpenEngine.dk (See AUTHORS)
+//
+// This program is free software; It is covered by the GNU General
+// Public License version 2 or any later version.
+// See the GNU General Public License for more details (see LICENSE).
+//--------------------------------------------------------------------
+
+// Usage: ASBenchmark [--json] [--max-faces N] [--frames N]
+//                    [--exhaustive-limit N] [--threads N]
+//
+// Generates terrain grids, architectural boxes and random triangle
+// soups from 1k faces up to the maximum, builds quad and BSP trees
+// with each strategy and renders a scripted camera path through every
+// tree with the AcceleratedRenderingView and plane mask culling,
+// counting the faces it would draw. One record is
+// written to stdout per scene, size and configuration, as CSV by
+// default or as a JSON array.
+//
+// Each configuration runs in a child process where fork is available,
+// so its peak resident size is not hidden by the high-water mark of
+// an earlier, larger configuration. The peak is reported as the
+// growth over the resident size the child started with.
+
+#include <Scene/SceneNode.h>
+#include <Scene/GeometryNode.h>
+#include <Scene/ISceneNodeVisitor.h>
+#include <Scene/QuadNode.h>
+#include <Scene/QuadTransformer.h>
+#include <Scene/BSPNode.h>
+#include <Scene/BSPTransformer.h>
+#include <Scene/BSPFindDividerStrategy.h>
+#include <Scene/BSPPartitionStrategy.h>
+#include <Scene/CullingPlanes.h>
+#include <Renderers/AcceleratedRenderingView.h>
+#include <Display/IViewingVolume.h>
+#include <Geometry/FaceSet.h>
+#include <Geometry/Box.h>
+#include <Math/Vector.h>
+#include <Math/Matrix.h>
+#include <Utils/Timer.h>
+
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#ifndef _WIN32
+#include <sys/resource.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
+
+using namespace OpenEngine;
+using namespace OpenEngine::Scene;
+using namespace OpenEngine::Geometry;
+using namespace OpenEngine::Math;
+using OpenEngine::Display::IViewingVolume;
+using OpenEngine::Renderers::AcceleratedRenderingView;
+using OpenEngine::Utils::Timer;
+
+namespace {
+
+const float extent = 1000.0f;   //!< side length of all scenes
+
+/**
+ * Deterministic pseudo random numbers, so runs are comparable.
+ */
+class Random {
+    unsigned int state;
+public:
+    Random(unsigned int seed) : state(seed) {}
+    float Next() {
+        state = state * 1664525 + 1013904223;
+        return (state >> 8) / 16777216.0f;
+    }
+    float Next(float lo, float hi) {
+        return lo + (hi - lo) * Next();
+    }
+};
+
+void AddFace(FaceSet* faces, Vector<3,float> a, Vector<3,float> b, Vector<3,float> c) {
+    faces->Add(FacePtr(new Face(a, b, c)));
+}
+
+void AddQuad(FaceSet* faces, Vector<3,float> a, Vector<3,float> b,
+             Vector<3,float> c, Vector<3,float> d) {
+    AddFace(faces, a, b, c);
+    AddFace(faces, a, c, d);
+}
+
+/**
+ * Height field with two faces per grid cell.
+ */
+FaceSet* MakeTerrain(unsigned int count) {
+    FaceSet* faces = new FaceSet();
+    unsigned int cells = (unsigned int)std::sqrt(count / 2.0f);
+    if (cells == 0) cells = 1;
+    float step = extent / cells;
+    for (unsigned int i = 0; i < cells; i++)
+        for (unsigned int j = 0; j < cells; j++) {
+            Vector<3,float> p[4];
+            for (unsigned int k = 0; k < 4; k++) {
+                float x = (i + (k == 1 || k == 2)) * step;
+                float z = (j + (k >= 2)) * step;
+                float y = 40.0f * std::sin(x * 0.01f) * std::cos(z * 0.013f);
+                p[k] = Vector<3,float>(x, y, z);
+            }
+            AddQuad(faces, p[0], p[1], p[2], p[3]);
+        }
+    return faces;
+}
+
+/**
+ * Axis aligned buildings of twelve faces each, standing on the
+ * ground plane.
+ */
+FaceSet* MakeBoxes(unsigned int count) {
+    FaceSet* faces = new FaceSet();
+    Random rand(17);
+    unsigned int boxes = (count + 11) / 12;
+    for (unsigned int i = 0; i < boxes; i++) {
+        float x = rand.Next(0, extent), z = rand.Next(0, extent);
+        float w = rand.Next(5, 40), d = rand.Next(5, 40), h = rand.Next(5, 60);
+        Vector<3,float> p[8];
+        for (unsigned int k = 0; k < 8; k++)
+            p[k] = Vector<3,float>(x + w * (k & 1), h * ((k >> 1) & 1), z + d * (k >> 2));
+        AddQuad(faces, p[0], p[1], p[3], p[2]); // front
+        AddQuad(faces, p[5], p[4], p[6], p[7]); // back
+        AddQuad(faces, p[4], p[0], p[2], p[6]); // left
+        AddQuad(faces, p[1], p[5], p[7], p[3]); // right
+        AddQuad(faces, p[2], p[3], p[7], p[6]); // top
+        AddQuad(faces, p[4], p[5], p[1], p[0]); // bottom
+    }
+    return faces;
+}
+
+/**
+ * Small triangles with random orientations filling a cube.
+ */
+FaceSet* MakeSoup(unsigned int count) {
+    FaceSet* faces = new FaceSet();
+    Random rand(4711);
+    for (unsigned int i = 0; i < count; i++) {
+        Vector<3,float> c(rand.Next(0, extent), rand.Next(0, extent / 4), rand.Next(0, extent));
+        Vector<3,float> v[3];
+        for (unsigned int k = 0; k < 3; k++)
+            v[k] = c + Vector<3,float>(rand.Next(-5, 5), rand.Next(-5, 5), rand.Next(-5, 5));
+        AddFace(faces, v[0], v[1], v[2]);
+    }
+    return faces;
+}
+
+/**
+ * Viewing volume of the scripted camera path. The camera circles the
+ * scene looking along the path, slightly towards the center.
+ */
+class ScriptedVolume : public IViewingVolume {
+    Vector<3,float> position;
+    Matrix<4,4,float> view, projection;
+    CullingPlanes planes;
+public:
+    ScriptedVolume(unsigned int frame, unsigned int frames) {
+        float t = 6.2831853f * frame / frames;
+        float c = extent * 0.5f;
+        position = Vector<3,float>(c + 0.4f * extent * std::cos(t), 60.0f,
+                                   c + 0.4f * extent * std::sin(t));
+        Vector<3,float> dir(-std::sin(t) - 0.3f * std::cos(t), -0.1f,
+                            std::cos(t) - 0.3f * std::sin(t));
+        dir.Normalize();
+
+        // view matrix for row vectors, the camera looks down -z
+        Vector<3,float> right = dir % Vector<3,float>(0, 1, 0);
+        right.Normalize();
+        Vector<3,float> up = right % dir;
+        Vector<3,float> axis[3] = { right, up, -dir };
+        for (unsigned int j = 0; j < 3; j++) {
+            for (unsigned int i = 0; i < 3; i++)
+                view(i,j) = axis[j][i];
+            view(j,3) = 0;
+            view(3,j) = -(axis[j] * position);
+        }
+        view(3,3) = 1;
+
+        // perspective projection, 0.6 radians half angle, aspect 4:3
+        const float zNear = 1.0f, zFar = extent, aspect = 4.0f / 3.0f;
+        float f = 1.0f / std::tan(0.6f);
+        for (unsigned int i = 0; i < 4; i++)
+            for (unsigned int j = 0; j < 4; j++)
+                projection(i,j) = 0;
+        projection(0,0) = f / aspect;
+        projection(1,1) = f;
+        projection(2,2) = (zFar + zNear) / (zNear - zFar);
+        projection(2,3) = -1;
+        projection(3,2) = 2 * zFar * zNear / (zNear - zFar);
+
+        planes.Extract(view * projection);
+    }
+
+    Vector<3,float> GetPosition() { return position; }
+    Matrix<4,4,float> GetViewMatrix() { return view; }
+    Matrix<4,4,float> GetProjectionMatrix() { return projection; }
+    bool IsVisible(const Box& box) {
+        unsigned int mask = CullingPlanes::ALL_PLANES, hint = 0;
+        return planes.Test(box, mask, hint);
+    }
+};
+
+/**
+ * Counts nodes, leaves and stored faces of a tree.
+ */
+class StatsVisitor : public ISceneNodeVisitor {
+public:
+    unsigned int nodes, leaves, faces;
+    StatsVisitor() : nodes(0), leaves(0), faces(0) {}
+    void VisitQuadNode(QuadNode* node) {
+        nodes++;
+        if (!node->GetTopLeft() && !node->GetTopRight() &&
+            !node->GetBottomLeft() && !node->GetBottomRight())
+            leaves++;
+        node->VisitSubNodes(*this);
+    }
+    void VisitBSPNode(BSPNode* node) {
+        nodes++;
+        if (!node->GetFront() && !node->GetBack()) leaves++;
+        node->VisitSubNodes(*this);
+    }
+    void VisitGeometryNode(GeometryNode* node) {
+        faces += node->GetFaceSet()->Size();
+    }
+};
+
+/**
+ * Accelerated rendering view counting the faces of the visible
+ * geometry instead of rendering them.
+ */
+class CountingView : public AcceleratedRenderingView {
+public:
+    unsigned long long faces;
+    CountingView() : faces(0) {}
+    void VisitGeometryNode(GeometryNode* node) {
+        faces += node->GetFaceSet()->Size();
+    }
+};
+
+struct Options {
+    bool json;
+    unsigned int maxFaces;
+    unsigned int frames;
+    unsigned int exhaustiveLimit;
+    unsigned int threads;
+};
+
+struct Record {
+    std::string scene, structure, config;
+    unsigned int faces;
+    unsigned int buildMs;
+    unsigned int nodes, leaves, stored, split;
+    long memoryKb, peakKb;
+    unsigned int frames;
+    unsigned long long traverseUs, visible;
+};
+
+long ResidentKb() {
+#ifdef __linux__
+    long pages = 0, resident = 0;
+    FILE* f = std::fopen("/proc/self/statm", "r");
+    if (!f) return 0;
+    if (std::fscanf(f, "%ld %ld", &pages, &resident) != 2) resident = 0;
+    std::fclose(f);
+    return resident * (sysconf(_SC_PAGESIZE) / 1024);
+#else
+    return 0;
+#endif
+}
+
+long PeakKb() {
+#ifndef _WIN32
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) != 0) return 0;
+#ifdef __APPLE__
+    return usage.ru_maxrss / 1024;
+#else
+    return usage.ru_maxrss;
+#endif
+#else
+    return 0;
+#endif
+}
+
+void Print(const Record& r, const Options& opt, bool first) {
+    if (opt.json) {
+        std::printf("%s\n  {\"scene\":\"%s\",\"faces\":%u,\"structure\":\"%s\","
+                    "\"config\":\"%s\",\"build_ms\":%u,\"nodes\":%u,"
+                    "\"leaves\":%u,\"stored_faces\":%u,\"split_faces\":%u,"
+                    "\"memory_kb\":%ld,\"peak_rss_kb\":%ld,\"frames\":%u,"
+                    "\"traverse_us\":%llu,\"visible_faces\":%llu}",
+                    first ? "" : ",", r.scene.c_str(), r.faces,
+                    r.structure.c_str(), r.config.c_str(), r.buildMs,
+                    r.nodes, r.leaves, r.stored, r.split, r.memoryKb,
+                    r.peakKb, r.frames, r.traverseUs, r.visible);
+    } else {
+        std::printf("%s,%u,%s,%s,%u,%u,%u,%u,%u,%ld,%ld,%u,%llu,%llu\n",
+                    r.scene.c_str(), r.faces, r.structure.c_str(),
+                    r.config.c_str(), r.buildMs, r.nodes, r.leaves,
+                    r.stored, r.split, r.memoryKb, r.peakKb, r.frames,
+                    r.traverseUs, r.visible);
+    }
+    std::fflush(stdout);
+}
+
+/**
+ * Build a tree with a transformer and measure it.
+ * The face set is owned by the scene and deleted with it.
+ */
+template <class T>
+Record Run(T& trans, FaceSet* faces, const Options& opt) {
+    Record r;
+    r.faces = faces->Size();
+    SceneNode* scene = new SceneNode();
+    scene->AddNode(new GeometryNode(faces));
+
+    long before = ResidentKb();
+    Timer timer;
+    timer.Start();
+    trans.Transform(*scene);
+    r.buildMs = timer.GetElapsedIntervals(1000);
+    r.memoryKb = ResidentKb() - before;
+
+    StatsVisitor stats;
+    scene->Accept(stats);
+    r.nodes = stats.nodes;
+    r.leaves = stats.leaves;
+    r.stored = stats.faces;
+    r.split = (stats.faces > r.faces) ? stats.faces - r.faces : 0;
+
+    std::vector<ScriptedVolume*> path;
+    for (unsigned int i = 0; i < opt.frames; i++)
+        path.push_back(new ScriptedVolume(i, opt.frames));
+    CountingView view;
+    view.SetPlaneMaskCulling(true);
+    r.frames = opt.frames;
+    timer.Reset();
+    timer.Start();
+    for (unsigned int i = 0; i < opt.frames; i++) {
+        view.SetViewingVolume(path[i]);
+        scene->Accept(view);
+    }
+    r.traverseUs = timer.GetElapsedTime().AsInt();
+    r.visible = view.faces;
+    for (unsigned int i = 0; i < path.size(); i++)
+        delete path[i];
+    delete scene;
+    return r;
+}
+
+BSPTransformer* MakeBSP(bool exhaustive, bool divide, bool indexed,
+                        const Options& opt) {
+    BSPTransformer* trans = new BSPTransformer();
+    if (!exhaustive)
+        trans->SetFindDividerStrategy(new BSPSampledFindDivider());
+    if (divide)
+        trans->SetPartitionStrategy(new BSPDivideStrategy());
+    trans->SetIndexedBuild(indexed);
+    if (opt.threads > 1)
+        trans->SetParallelBuild(opt.threads);
+    return trans;
+}
+
+/**
+ * Generate a scene, build and measure one configuration and print
+ * its record.
+ */
+void RunConfig(unsigned int scene, unsigned int size, unsigned int config,
+               const Options& opt, bool first) {
+    static const char* scenes[] = { "terrain", "boxes", "soup" };
+    long base = PeakKb();
+    FaceSet* faces = (scene == 0) ? MakeTerrain(size)
+        : (scene == 1) ? MakeBoxes(size) : MakeSoup(size);
+    Record r;
+    if (config == 0) {
+        QuadTransformer quad;
+        r = Run(quad, faces, opt);
+        r.structure = "quad";
+        r.config = "count500-hsize100";
+    } else {
+        bool divide = (config == 2 || config == 4);
+        BSPTransformer* bsp = MakeBSP(config <= 2, divide, config == 5, opt);
+        r = Run(*bsp, faces, opt);
+        delete bsp;
+        r.structure = "bsp";
+        r.config = std::string((config <= 2) ? "default" : "sampled") +
+            ((divide) ? "-divide" : "-split") +
+            ((config == 5) ? "-indexed" : "");
+    }
+    r.peakKb = PeakKb() - base;
+    r.scene = scenes[scene];
+    Print(r, opt, first);
+}
+
+/**
+ * Run a configuration in a child process, so the peak resident size
+ * is measured per configuration.
+ *
+ * @return True if a record was printed.
+ */
+bool RunIsolated(unsigned int scene, unsigned int size, unsigned int config,
+                 const Options& opt, bool first) {
+#ifndef _WIN32
+    std::fflush(stdout);
+    pid_t pid = fork();
+    if (pid == 0) {
+        RunConfig(scene, size, config, opt, first);
+        std::fflush(stdout);
+        _exit(0);
+    }
+    if (pid > 0) {
+        int status = 0;
+        if (waitpid(pid, &status, 0) == pid &&
+            WIFEXITED(status) && WEXITSTATUS(status) == 0)
+            return true;
+        std::fprintf(stderr, "configuration %u of scene %u with %u faces failed\n",
+                     config, scene, size);
+        return false;
+    }
+    // no child, measure in this process instead
+#endif
+    RunConfig(scene, size, config, opt, first);
+    return true;
+}
+
+} // anonymous namespace
+
+int main(int argc, char** argv) {
+    Options opt;
+    opt.json = false;
+    opt.maxFaces = 1000000;
+    opt.frames = 256;
+    opt.exhaustiveLimit = 10000;
+    opt.threads = 1;
+    for (int i = 1; i < argc; i++) {
+        if (std::strcmp(argv[i], "--json") == 0)
+            opt.json = true;
+        else if (i + 1 < argc && std::strcmp(argv[i], "--max-faces") == 0)
+            opt.maxFaces = std::atoi(argv[++i]);
+        else if (i + 1 < argc && std::strcmp(argv[i], "--frames") == 0)
+            opt.frames = std::atoi(argv[++i]);
+        else if (i + 1 < argc && std::strcmp(argv[i], "--exhaustive-limit") == 0)
+            opt.exhaustiveLimit = std::atoi(argv[++i]);
+        else if (i + 1 < argc && std::strcmp(argv[i], "--threads") == 0)
+            opt.threads = std::atoi(argv[++i]);
+        else {
+            std::fprintf(stderr, "usage: %s [--json] [--max-faces N] [--frames N]"
+                         " [--exhaustive-limit N] [--threads N]\n", argv[0]);
+            return 1;
+        }
+    }
+
+    if (opt.json) std::printf("[");
+    else std::printf("scene,faces,structure,config,build_ms,nodes,leaves,"
+                     "stored_faces,split_faces,memory_kb,peak_rss_kb,"
+                     "frames,traverse_us,visible_faces\n");
+    bool first = true;
+    for (unsigned int size = 1000; size <= opt.maxFaces; size *= 10) {
+        for (unsigned int s = 0; s < 3; s++) {
+            // the exhaustive divider search is quadratic in the face count
+            bool exhaustive = size <= opt.exhaustiveLimit;
+            for (unsigned int c = 0; c < 6; c++) {
+                if (c >= 1 && c <= 2 && !exhaustive) continue;
+                if (RunIsolated(s, size, c, opt, first)) first = false;
+            }
+        }
+        if (size > opt.maxFaces / 10) break;
+    }
+    if (opt.json) std::printf("\n]\n");
+    return 0;
+}
@@ -0,0 +1,119 @@
+// Condition variable with its own mutex.
+// -------------------------------------------------------------------
+// Copyright (C) 2007 OpenEngine.dk (See AUTHORS) 
+// 
+// This program is free software; It is covered by the GNU General 
+// Public License version 2 or any later version. 
+// See the GNU General Public License for more details (see LICENSE). 
+//--------------------------------------------------------------------
+
+#include <Core/Condition.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <pthread.h>
+#endif
+
+namespace OpenEngine {
+namespace Core {
+
+#ifdef _WIN32
+struct Condition::Impl {
+    CRITICAL_SECTION lock;
+    CONDITION_VARIABLE cond;
+};
+#else
+struct Condition::Impl {
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+};
+#endif
+
+/**
+ * Create a condition.
+ */
+Condition::Condition() : impl(new Impl()) {
+#ifdef _WIN32
+    InitializeCriticalSection(&impl->lock);
+    InitializeConditionVariable(&impl->cond);
+#else
+    pthread_mutex_init(&impl->lock, NULL);
+    pthread_cond_init(&impl->cond, NULL);
+#endif
+}
+
+/**
+ * Destructor.
+ * No threads may wait on the condition.
+ */
+Condition::~Condition() {
+#ifdef _WIN32
+    DeleteCriticalSection(&impl->lock);
+#else
+    pthread_cond_destroy(&impl->cond);
+    pthread_mutex_destroy(&impl->lock);
+#endif
+    delete impl;
+}
+
+/**
+ * Lock the mutex of the condition.
+ */
+void Condition::Lock() {
+#ifdef _WIN32
+    EnterCriticalSection(&impl->lock);
+#else
+    pthread_mutex_lock(&impl->lock);
+#endif
+}
+
+/**
+ * Unlock the mutex of the condition.
+ */
+void Condition::Unlock() {
+#ifdef _WIN32
+    LeaveCriticalSection(&impl->lock);
+#else
+    pthread_mutex_unlock(&impl->lock);
+#endif
+}
+
+/**
+ * Release the lock and block until the condition is signalled, then
+ * take the lock again.
+ *
+ * @pre The calling thread holds the lock.
+ */
+void Condition::Wait() {
+#ifdef _WIN32
+    SleepConditionVariableCS(&impl->cond, &impl->lock, INFINITE);
+#else
+    pthread_cond_wait(&impl->cond, &impl->lock);
+#endif
+}
+
+/**
+ * Wake one waiting thread.
+ */
+void Condition::Signal() {
+#ifdef _WIN32
+    WakeConditionVariable(&impl->cond);
+#else
+    pthread_cond_signal(&impl->cond);
+#endif
+}
+
+/**
+ * Wake all waiting threads.
+ */
+void Condition::Broadcast() {
+#ifdef _WIN32
+    WakeAllConditionVariable(&impl->cond);
+#else
+    pthread_cond_broadcast(&impl->cond);
+#endif
+}
+
+} // NS Core
+} // NS OpenEngine
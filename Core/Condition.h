@@ -0,0 +1,55 @@
+// Condition variable with its own mutex.
+// -------------------------------------------------------------------
+// Copyright (C) 2007 OpenEngine.dk (See AUTHORS) 
+// 
+// This program is free software; It is covered by the GNU General 
+// Public License version 2 or any later version. 
+// See the GNU General Public License for more details (see LICENSE). 
+//--------------------------------------------------------------------
+
+#ifndef _OE_CONDITION_H_
+#define _OE_CONDITION_H_
+
+namespace OpenEngine {
+namespace Core {
+
+/**
+ * Condition variable with its own mutex.
+ *
+ * Threads block in Wait() until another thread signals the
+ * condition. The state the waiters test must be guarded by the lock
+ * of the condition, and Wait() must be called in a loop re-testing
+ * the state, as waits can wake up spuriously.
+ *
+ * @code
+ * cond.Lock();
+ * while (!ready) cond.Wait();
+ * cond.Unlock();
+ * @endcode
+ *
+ * @class Condition Condition.h Core/Condition.h
+ */
+class Condition {
+private:
+    struct Impl;
+    Impl* impl;
+
+    // not copyable
+    Condition(const Condition&);
+    Condition& operator=(const Condition&);
+
+public:
+    Condition();
+    ~Condition();
+
+    void Lock();
+    void Unlock();
+    void Wait();
+    void Signal();
+    void Broadcast();
+};
+
+} // NS Core
+} // NS OpenEngine
+
+#endif // _OE_CONDITION_H_
@@ -0,0 +1,228 @@
+// Work stealing thread pool.
+// -------------------------------------------------------------------
+// Copyright (C) 2007 OpenEngine.dk (See AUTHORS) 
+// 
+// This program is free software; It is covered by the GNU General 
+// Public License version 2 or any later version. 
+// See the GNU General Public License for more details (see LICENSE). 
+//--------------------------------------------------------------------
+
+#include <Core/WorkStealingPool.h>
+#include <Core/Thread.h>
+#include <cstddef>
+
+namespace OpenEngine {
+namespace Core {
+
+/**
+ * Worker thread running the work loop of the pool.
+ */
+class WorkStealingPool::Worker : public Thread {
+private:
+    WorkStealingPool& pool;
+    unsigned int index;
+public:
+    Worker(WorkStealingPool& pool, unsigned int index)
+        : pool(pool), index(index) {}
+    void Run() {
+        pool.Work(index);
+    }
+};
+
+void TaskGroup::Add() {
+    lock.Lock();
+    ++pending;
+    lock.Unlock();
+}
+
+/**
+ * Account a finished task.
+ * The group may be destroyed by its waiter as soon as the last task
+ * is accounted, so it must not be touched after this returns true.
+ *
+ * @return True if it was the last pending task of the group.
+ */
+bool TaskGroup::Done() {
+    lock.Lock();
+    bool done = --pending == 0;
+    lock.Unlock();
+    return done;
+}
+
+bool TaskGroup::IsDone() {
+    lock.Lock();
+    bool done = pending == 0;
+    lock.Unlock();
+    return done;
+}
+
+/**
+ * Create a pool and start its worker threads.
+ *
+ * @param threads Number of worker threads.
+ */
+WorkStealingPool::WorkStealingPool(unsigned int threads)
+    : epoch(0), running(true) {
+    for (unsigned int i = 0; i <= threads; i++)
+        queues.push_back(new Queue());
+    for (unsigned int i = 0; i < threads; i++) {
+        workers.push_back(new Worker(*this, i));
+        workers.back()->Start();
+    }
+}
+
+/**
+ * Destructor.
+ * Stops and joins all worker threads. Tasks still queued are deleted
+ * without being run.
+ */
+WorkStealingPool::~WorkStealingPool() {
+    work.Lock();
+    running = false;
+    work.Broadcast();
+    work.Unlock();
+    for (unsigned int i = 0; i < workers.size(); i++) {
+        workers[i]->Wait();
+        delete workers[i];
+    }
+    for (unsigned int i = 0; i < queues.size(); i++) {
+        std::deque<Entry>& entries = queues[i]->entries;
+        for (std::deque<Entry>::iterator itr = entries.begin();
+             itr != entries.end(); itr++)
+            delete itr->task;
+        delete queues[i];
+    }
+}
+
+/**
+ * Get the number of worker threads.
+ *
+ * @return Worker thread count.
+ */
+unsigned int WorkStealingPool::GetThreadCount() {
+    return workers.size();
+}
+
+/**
+ * Get the worker index to use from threads outside the pool.
+ *
+ * @return External worker index.
+ */
+unsigned int WorkStealingPool::GetExternalWorker() {
+    return workers.size();
+}
+
+/**
+ * Submit a task to the queue of a worker.
+ * The pool takes ownership of the task and deletes it once it has
+ * been run.
+ *
+ * @param task Task to run.
+ * @param group Group the task is accounted in.
+ * @param worker Index of the submitting worker.
+ */
+void WorkStealingPool::Submit(ITask* task, TaskGroup& group,
+                              unsigned int worker) {
+    Entry entry;
+    entry.task = task;
+    entry.group = &group;
+    group.Add();
+    Queue* q = queues[worker];
+    q->lock.Lock();
+    q->entries.push_back(entry);
+    q->lock.Unlock();
+    work.Lock();
+    epoch++;
+    work.Signal();
+    work.Unlock();
+}
+
+/**
+ * Wait for all tasks of a group to finish.
+ * The waiting thread runs queued tasks while it waits.
+ *
+ * @param group Group to wait for.
+ * @param worker Index of the waiting worker.
+ */
+void WorkStealingPool::Wait(TaskGroup& group, unsigned int worker) {
+    Entry entry;
+    while (Next(worker, entry, &group))
+        Execute(entry, worker);
+}
+
+/**
+ * Get the next task for a worker, blocking while there is none.
+ * The epoch is read before looking in the queues, so a submit or
+ * completion after the look always ends the wait.
+ *
+ * @param worker Index of the worker.
+ * @param entry Entry of the task found.
+ * @param group Group waited for, NULL to run until the pool stops.
+ * @return True if a task was found, false if the group is done or
+ *         the pool stops.
+ */
+bool WorkStealingPool::Next(unsigned int worker, Entry& entry,
+                            TaskGroup* group) {
+    for (;;) {
+        work.Lock();
+        unsigned int seen = epoch;
+        bool stop = (group) ? group->IsDone() : !running;
+        work.Unlock();
+        if (stop) return false;
+        if (Pop(worker, entry) || Steal(worker, entry)) return true;
+        work.Lock();
+        while (epoch == seen && running) work.Wait();
+        work.Unlock();
+    }
+}
+
+bool WorkStealingPool::Pop(unsigned int worker, Entry& entry) {
+    Queue* q = queues[worker];
+    bool found = false;
+    q->lock.Lock();
+    if (!q->entries.empty()) {
+        entry = q->entries.back();
+        q->entries.pop_back();
+        found = true;
+    }
+    q->lock.Unlock();
+    return found;
+}
+
+bool WorkStealingPool::Steal(unsigned int worker, Entry& entry) {
+    unsigned int count = queues.size();
+    for (unsigned int i = 1; i < count; i++) {
+        Queue* q = queues[(worker + i) % count];
+        bool found = false;
+        q->lock.Lock();
+        if (!q->entries.empty()) {
+            entry = q->entries.front();
+            q->entries.pop_front();
+            found = true;
+        }
+        q->lock.Unlock();
+        if (found) return true;
+    }
+    return false;
+}
+
+void WorkStealingPool::Execute(Entry& entry, unsigned int worker) {
+    entry.task->Run(*this, worker);
+    delete entry.task;
+    // only waiters on a finished group need waking
+    if (entry.group->Done()) {
+        work.Lock();
+        epoch++;
+        work.Broadcast();
+        work.Unlock();
+    }
+}
+
+void WorkStealingPool::Work(unsigned int worker) {
+    Entry entry;
+    while (Next(worker, entry, NULL))
+        Execute(entry, worker);
+}
+
+} // NS Core
+} // NS OpenEngine
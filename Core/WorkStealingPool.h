@@ -0,0 +1,119 @@
+// Work stealing thread pool.
+// -------------------------------------------------------------------
+// Copyright (C) 2007 OpenEngine.dk (See AUTHORS) 
+// 
+// This program is free software; It is covered by the GNU General 
+// Public License version 2 or any later version. 
+// See the GNU General Public License for more details (see LICENSE). 
+//--------------------------------------------------------------------
+
+#ifndef _OE_WORK_STEALING_POOL_H_
+#define _OE_WORK_STEALING_POOL_H_
+
+#include <Core/Mutex.h>
+#include <Core/Condition.h>
+#include <deque>
+#include <vector>
+
+namespace OpenEngine {
+namespace Core {
+
+class WorkStealingPool;
+
+/**
+ * Task interface for the work stealing pool.
+ *
+ * @class ITask WorkStealingPool.h Core/WorkStealingPool.h
+ */
+class ITask {
+public:
+    virtual ~ITask() {}
+    /**
+     * Run the task.
+     *
+     * @param pool Pool running the task.
+     * @param worker Index of the worker running the task. Sub tasks
+     *               should be submitted with this index.
+     */
+    virtual void Run(WorkStealingPool& pool, unsigned int worker) = 0;
+};
+
+/**
+ * Group of outstanding tasks that can be waited for.
+ *
+ * @class TaskGroup WorkStealingPool.h Core/WorkStealingPool.h
+ */
+class TaskGroup {
+private:
+    Mutex lock;
+    unsigned int pending;
+public:
+    TaskGroup() : pending(0) {}
+    void Add();
+    bool Done();
+    bool IsDone();
+};
+
+/**
+ * Work stealing thread pool.
+ *
+ * Each worker owns a task queue. New tasks are pushed on the queue
+ * of the submitting worker and taken from the same end, so a worker
+ * runs its own tasks depth first. Idle workers steal the oldest
+ * tasks from the other queues, which for fork-join recursion are the
+ * largest ones.
+ *
+ * Threads outside the pool, such as the one creating it, use the
+ * extra worker index GetExternalWorker() when submitting and
+ * waiting. Waiting on a group runs pending tasks instead of blocking,
+ * so nested fork-join does not deadlock. Threads with nothing to run
+ * block on a condition until a task is submitted or completes.
+ *
+ * @code
+ * WorkStealingPool pool(4);
+ * TaskGroup group;
+ * pool.Submit(new MyTask(), group, pool.GetExternalWorker());
+ * pool.Wait(group, pool.GetExternalWorker());
+ * @endcode
+ *
+ * @class WorkStealingPool WorkStealingPool.h Core/WorkStealingPool.h
+ */
+class WorkStealingPool {
+private:
+    class Worker;
+    struct Entry {
+        ITask* task;
+        TaskGroup* group;
+    };
+    struct Queue {
+        Mutex lock;
+        std::deque<Entry> entries;
+    };
+
+    std::vector<Queue*> queues; //!< one queue per worker plus the external
+    std::vector<Worker*> workers;
+    Condition work;             //!< signalled on submits and completions
+    unsigned int epoch;         //!< count of submits and completions
+    bool running;
+
+    bool Next(unsigned int worker, Entry& entry, TaskGroup* group);
+    bool Pop(unsigned int worker, Entry& entry);
+    bool Steal(unsigned int worker, Entry& entry);
+    void Execute(Entry& entry, unsigned int worker);
+    void Work(unsigned int worker);
+
+public:
+    WorkStealingPool(unsigned int threads);
+    virtual ~WorkStealingPool();
+
+    unsigned int GetThreadCount();
+    unsigned int GetExternalWorker();
+
+    void Submit(ITask* task, TaskGroup& group, unsigned int worker);
+    void Wait(TaskGroup& group, unsigned int worker);
+};
+
+} // NS Core
+} // NS OpenEngine
+
+#endif // _OE_WORK_STEALING_POOL_H_
@@ -12,6 +12,10 @@
 
 #include <Scene/BSPNode.h>
 #include <Scene/QuadNode.h>
+#include <Scene/OctNode.h>
+#include <Scene/GeometryNode.h>
+#include <Scene/LeafPager.h>
+#include <cmath>
 
 namespace OpenEngine {
 namespace Renderers {
@@ -19,10 +23,32 @@ namespace Renderers {
 using namespace OpenEngine::Scene;
 using namespace OpenEngine::Display;
 
+// distance from a point to a box, zero inside
+static float Distance(const Box& box, Vector<3,float> p) {
+    Vector<3,float> c = box.GetCenter();
+    Vector<3,float> e = box.GetCorner();
+    float dist = 0;
+    for (unsigned int i = 0; i < 3; i++) {
+        float d = std::fabs(p[i] - c[i]) - std::fabs(e[i]);
+        if (d > 0) dist += d * d;
+    }
+    return std::sqrt(dist);
+}
+
 //! Rendering view constructor.
 AcceleratedRenderingView::AcceleratedRenderingView()
     : ISceneNodeVisitor(), 
-      vv(NULL)
+      vv(NULL),
+      bspOrder(BSP_TREE_ORDER),
+      planeMasks(false),
+      mask(CullingPlanes::ALL_PLANES),
+      depth(0),
+      pager(NULL),
+      prefetch(0),
+      quads(0),
+      lodThreshold(0),
+      lodHeight(0),
+      lodScale(0)
 {
 }    
 
@@ -34,16 +60,221 @@ void AcceleratedRenderingView::SetViewingVolume(IViewingVolume* vv) {
     this->vv = vv;
 }
 
+IViewingVolume* AcceleratedRenderingView::GetViewingVolume() {
+    return vv;
+}
+
+/**
+ * Set the traversal order of BSP trees.
+ * The default is BSP_TREE_ORDER.
+ *
+ * @param order BSP traversal order.
+ */
+void AcceleratedRenderingView::SetBSPOrder(BSPOrder order) {
+    bspOrder = order;
+}
+
+/**
+ * Get the traversal order of BSP trees.
+ *
+ * @return BSP traversal order.
+ */
+AcceleratedRenderingView::BSPOrder AcceleratedRenderingView::GetBSPOrder() {
+    return bspOrder;
+}
+
+/**
+ * Enable or disable plane mask culling of the tree nodes.
+ * It is disabled by default, which tests every node with the
+ * viewing volume.
+ *
+ * @param enable True to cull with plane masks.
+ */
+void AcceleratedRenderingView::SetPlaneMaskCulling(bool enable) {
+    planeMasks = enable;
+}
+
+/**
+ * Check if plane mask culling is enabled.
+ *
+ * @return True if tree nodes are culled with plane masks.
+ */
+bool AcceleratedRenderingView::GetPlaneMaskCulling() {
+    return planeMasks;
+}
+
+/**
+ * Set the pager of quad trees built with paged leaves.
+ * The pager is updated when a quad tree is entered, making loaded
+ * leaves resident and evicting leaves over its memory budget.
+ *
+ * @param pager Leaf pager, not owned by the view, or NULL.
+ * @param prefetch Distance from the viewing volume position within
+ *                 which leaves are requested before they are visible.
+ */
+void AcceleratedRenderingView::SetLeafPager(LeafPager* pager, float prefetch) {
+    this->pager = pager;
+    this->prefetch = prefetch;
+}
+
+/**
+ * Set the screen space error threshold of the quad node proxies.
+ * A proxy is drawn instead of its sub tree when its error, projected
+ * to the closest point of the node bounds, is below the threshold.
+ *
+ * @param pixels Threshold in pixels, zero disables the proxies.
+ * @param viewportHeight Height of the viewport in pixels.
+ */
+void AcceleratedRenderingView::SetLODThreshold(float pixels,
+                                               float viewportHeight) {
+    lodThreshold = pixels;
+    lodHeight = viewportHeight;
+}
+
+/**
+ * Request the paged leaves of a sub tree within the prefetch radius.
+ *
+ * @param node Quad node.
+ */
+void AcceleratedRenderingView::Prefetch(QuadNode* node) {
+    if (Distance(node->GetBoundingBox(), vv->GetPosition()) > prefetch)
+        return;
+    if (node->GetPage() >= 0) pager->Request(node->GetPage());
+    QuadNode* children[4] = { node->GetTopLeft(), node->GetTopRight(),
+                              node->GetBottomLeft(), node->GetBottomRight() };
+    for (unsigned int i = 0; i < 4; i++)
+        if (children[i]) Prefetch(children[i]);
+}
+
+/**
+ * Enter a tree node with plane mask culling.
+ * The planes are extracted when the root of a tree is entered.
+ *
+ * @param box Bounding box of the node.
+ * @param hint Culling hint of the node.
+ * @param[out] saved Mask of the parent to restore on leaving.
+ * @return True if the node is visible and must be left again.
+ */
+bool AcceleratedRenderingView::Enter(const Box& box, unsigned int& hint,
+                                     unsigned int& saved) {
+    if (depth == 0) {
+        planes.Extract(*vv);
+        mask = CullingPlanes::ALL_PLANES;
+    }
+    saved = mask;
+    unsigned int m = mask;
+    if (!planes.Test(box, m, hint)) return false;
+    mask = m;
+    depth++;
+    return true;
+}
+
+/**
+ * Leave a tree node entered with Enter.
+ *
+ * @param saved Mask of the parent.
+ */
+void AcceleratedRenderingView::Leave(unsigned int saved) {
+    mask = saved;
+    depth--;
+}
+
 void AcceleratedRenderingView::VisitQuadNode(QuadNode* node) {
 #if OE_SAFE
     if (!vv) throw Exception("Accelerated visitor with NULL viewing volume.");
 #endif
-    if (vv->IsVisible(node->GetBoundingBox()))
+    if (quads == 0) {
+        if (pager) pager->Update();
+        // the vertical focal length of the projection in pixels
+        if (lodThreshold > 0)
+            lodScale = vv->GetProjectionMatrix()(1,1) * lodHeight * 0.5f;
+    }
+    unsigned int saved = 0;
+    bool visible;
+    if (planeMasks) {
+        unsigned int hint = node->GetCullingHint();
+        visible = Enter(node->GetBoundingBox(), hint, saved);
+        node->SetCullingHint(hint);
+    }
+    else visible = vv->IsVisible(node->GetBoundingBox());
+    if (!visible) {
+        if (pager && prefetch > 0) Prefetch(node);
+        return;
+    }
+    GeometryNode* proxy = node->GetProxy();
+    if (proxy && lodThreshold > 0) {
+        float dist = Distance(node->GetBoundingBox(), vv->GetPosition());
+        if (node->GetProxyError() * lodScale < lodThreshold * dist) {
+            proxy->Accept(*this);
+            if (planeMasks) Leave(saved);
+            return;
+        }
+    }
+    quads++;
+    if (pager && node->GetPage() >= 0) {
+        GeometryNode* geom = pager->Get(node->GetPage());
+        if (geom) geom->Accept(*this);
+    }
+    node->VisitSubNodes(*this);
+    quads--;
+    if (planeMasks) Leave(saved);
+}
+
+void AcceleratedRenderingView::VisitOctNode(OctNode* node) {
+#if OE_SAFE
+    if (!vv) throw Exception("Accelerated visitor with NULL viewing volume.");
+#endif
+    if (planeMasks) {
+        unsigned int hint = node->GetCullingHint(), saved;
+        bool visible = Enter(node->GetBoundingBox(), hint, saved);
+        node->SetCullingHint(hint);
+        if (!visible) return;
+        node->VisitSubNodes(*this);
+        Leave(saved);
+    }
+    else if (vv->IsVisible(node->GetBoundingBox()))
         node->VisitSubNodes(*this);
 }
 
 void AcceleratedRenderingView::VisitBSPNode(BSPNode* node) {
-    node->VisitSubNodes(*this);
+#if OE_SAFE
+    if (!vv) throw Exception("Accelerated visitor with NULL viewing volume.");
+#endif
+    if (planeMasks) {
+        unsigned int hint = node->GetCullingHint(), saved;
+        bool visible = Enter(node->GetBoundingBox(), hint, saved);
+        node->SetCullingHint(hint);
+        if (!visible) return;
+        VisitBSPOrdered(node);
+        Leave(saved);
+    }
+    else if (vv->IsVisible(node->GetBoundingBox()))
+        VisitBSPOrdered(node);
+}
+
+/**
+ * Visit the sub nodes of a visible BSP node in the BSP order.
+ *
+ * @param node BSP node.
+ */
+void AcceleratedRenderingView::VisitBSPOrdered(BSPNode* node) {
+    if (bspOrder == BSP_TREE_ORDER) {
+        node->VisitSubNodes(*this);
+        return;
+    }
+    // the near side is the one containing the viewpoint
+    bool infront = node->ComparePoint(vv->GetPosition()) >= 0;
+    BSPNode* nearer  = (infront) ? node->GetFront() : node->GetBack();
+    BSPNode* farther = (infront) ? node->GetBack()  : node->GetFront();
+    BSPNode* first = (bspOrder == BSP_BACK_TO_FRONT) ? farther : nearer;
+    BSPNode* last  = (bspOrder == BSP_BACK_TO_FRONT) ? nearer : farther;
+
+    if (first != NULL) first->Accept(*this);
+    node->GetSpanNode()->Accept(*this);
+    for (list<ISceneNode*>::iterator itr = node->subNodes.begin();
+         itr != node->subNodes.end(); itr++)
+        (*itr)->Accept(*this);
+    if (last != NULL) last->Accept(*this);
 }
 
 } // NS Renderers
@@ -11,11 +11,14 @@
 #define _ACCELERATED_RENDERING_VIEW_H_
 
 #include <Scene/ISceneNodeVisitor.h>
+#include <Scene/CullingPlanes.h>
 
 namespace OpenEngine {
     namespace Scene {
         class BSPNode;
         class QuadNode;
+        class OctNode;
+        class LeafPager;
     }
     namespace Display{
         class IViewingVolume;
@@ -24,21 +27,78 @@ namespace Renderers {
     using Display::IViewingVolume;
     using Scene::BSPNode;
     using Scene::QuadNode;
+    using Scene::OctNode;
     using Scene::ISceneNodeVisitor;
 
 /**
  * Accelerated rendering view.
+ *
+ * BSP trees can be traversed in viewpoint order, using the position
+ * of the viewing volume. Back to front order renders transparent
+ * faces correctly without sorting, front to back order gives the
+ * best early depth rejection.
+ *
+ * With plane mask culling the frustum planes are extracted once per
+ * tree and a mask of the planes still intersecting is carried down
+ * the tree. Sub trees entirely inside the frustum are then accepted
+ * without tests, and each node remembers the plane that culled it
+ * last, which is tested first in the next frame.
+ *
+ * Quad nodes with level of detail proxies are drawn as their proxy,
+ * without descending, when the projected error of the proxy is below
+ * the screen space threshold.
+ *
+ * Quad trees built with a LeafPager are paged in as they are
+ * rendered. Leaves within the prefetch radius of the viewing volume
+ * position are requested ahead of time, also when not visible.
+ *
+ * @see CullingPlanes
+ * @see LeafPager
  */
 class AcceleratedRenderingView : virtual public ISceneNodeVisitor {
+public:
+    //! Traversal orders of BSP trees.
+    enum BSPOrder {
+        BSP_TREE_ORDER,     //!< front, span, back as stored
+        BSP_BACK_TO_FRONT,  //!< farthest faces first
+        BSP_FRONT_TO_BACK   //!< nearest faces first
+    };
+
 private:
     IViewingVolume* vv;
+    BSPOrder bspOrder;
+    bool planeMasks;
+    Scene::CullingPlanes planes;
+    unsigned int mask;   //!< planes intersecting the current node
+    unsigned int depth;  //!< tree nodes entered
+    Scene::LeafPager* pager;
+    float prefetch;      //!< prefetch radius of paged leaves
+    unsigned int quads;  //!< quad nodes entered
+    float lodThreshold;  //!< max projected proxy error in pixels
+    float lodHeight;     //!< viewport height in pixels
+    float lodScale;      //!< pixels per unit of error at distance one
+
+    bool Enter(const Geometry::Box& box, unsigned int& hint,
+               unsigned int& saved);
+    void Leave(unsigned int saved);
+    void VisitBSPOrdered(BSPNode* node);
+    void Prefetch(QuadNode* node);
+
 public:
     AcceleratedRenderingView();
     virtual ~AcceleratedRenderingView();
 
     void SetViewingVolume(IViewingVolume* vv);
+    IViewingVolume* GetViewingVolume();
+    void SetBSPOrder(BSPOrder order);
+    BSPOrder GetBSPOrder();
+    void SetPlaneMaskCulling(bool enable);
+    bool GetPlaneMaskCulling();
+    void SetLeafPager(Scene::LeafPager* pager, float prefetch = 0);
+    void SetLODThreshold(float pixels, float viewportHeight);
 
     void VisitQuadNode(QuadNode* node);
+    void VisitOctNode(OctNode* node);
     void VisitBSPNode(BSPNode* node);
 };
 
@@ -0,0 +1,95 @@
+// Queue of visible geometry.
+// -------------------------------------------------------------------
+// Copyright (C) 2007 OpenEngine.dk (See AUTHORS)
+//
+// This program is free software; It is covered by the GNU General
+// Public License version 2 or any later version.
+// See the GNU General Public License for more details (see LICENSE).
+//--------------------------------------------------------------------
+
+#include <Renderers/RenderQueue.h>
+#include <algorithm>
+
+namespace OpenEngine {
+namespace Renderers {
+
+// state first, then front to back within a state
+static bool StateOrder(const RenderQueue::Item& a, const RenderQueue::Item& b) {
+    if (a.state != b.state) return a.state < b.state;
+    return a.depth < b.depth;
+}
+
+static bool FrontToBack(const RenderQueue::Item& a, const RenderQueue::Item& b) {
+    return a.depth < b.depth;
+}
+
+static bool BackToFront(const RenderQueue::Item& a, const RenderQueue::Item& b) {
+    return a.depth > b.depth;
+}
+
+/**
+ * Create an empty queue.
+ */
+RenderQueue::RenderQueue() {
+
+}
+
+/**
+ * Remove all items, keeping the allocated memory.
+ */
+void RenderQueue::Clear() {
+    items.clear();
+}
+
+/**
+ * Add an item.
+ *
+ * @param item Visible geometry.
+ */
+void RenderQueue::Add(const Item& item) {
+    items.push_back(item);
+}
+
+/**
+ * Get the number of items.
+ *
+ * @return Item count.
+ */
+unsigned int RenderQueue::GetSize() const {
+    return items.size();
+}
+
+/**
+ * Get an item.
+ *
+ * @param index Item index, in queue order.
+ * @return Item.
+ */
+const RenderQueue::Item& RenderQueue::GetItem(unsigned int index) const {
+    return items[index];
+}
+
+/**
+ * Sort the items by render state, and front to back within a state.
+ * Items of the same state are then submitted together.
+ */
+void RenderQueue::SortByState() {
+    std::sort(items.begin(), items.end(), StateOrder);
+}
+
+/**
+ * Sort the items front to back, for early depth rejection.
+ */
+void RenderQueue::SortFrontToBack() {
+    std::sort(items.begin(), items.end(), FrontToBack);
+}
+
+/**
+ * Sort the items back to front, for blending.
+ */
+void RenderQueue::SortBackToFront() {
+    std::sort(items.begin(), items.end(), BackToFront);
+}
+
+} // NS Renderers
+} // NS OpenEngine
@@ -0,0 +1,72 @@
+// Queue of visible geometry.
+// -------------------------------------------------------------------
+// Copyright (C) 2007 OpenEngine.dk (See AUTHORS)
+//
+// This program is free software; It is covered by the GNU General
+// Public License version 2 or any later version.
+// See the GNU General Public License for more details (see LICENSE).
+//--------------------------------------------------------------------
+
+#ifndef _OE_RENDER_QUEUE_H_
+#define _OE_RENDER_QUEUE_H_
+
+#include <Math/Matrix.h>
+#include <vector>
+
+namespace OpenEngine {
+    namespace Scene {
+        class GeometryNode;
+    }
+namespace Renderers {
+
+using Scene::GeometryNode;
+
+/**
+ * Queue of visible geometry.
+ *
+ * A flat list of the geometry nodes found visible by a
+ * RenderQueueBuilder, each with its accumulated transformation, its
+ * depth along the view direction and a render state key. The queue
+ * can be sorted before it is submitted, by state to batch draw
+ * calls or by depth.
+ *
+ * Clearing keeps the allocated memory, so a queue reused every frame
+ * stops allocating once it has reached the size of the largest frame.
+ *
+ * @see RenderQueueBuilder
+ *
+ * @class RenderQueue RenderQueue.h Renderers/RenderQueue.h
+ */
+class RenderQueue {
+public:
+    /**
+     * Visible geometry.
+     */
+    struct Item {
+        GeometryNode* node;             //!< visible geometry
+        Matrix<4,4,float> transform;    //!< accumulated transformation
+        float depth;                    //!< view depth of the bounds center
+        const void* state;              //!< material of the first face
+    };
+
+private:
+    std::vector<Item> items;
+
+public:
+    RenderQueue();
+
+    void Clear();
+    void Add(const Item& item);
+
+    unsigned int GetSize() const;
+    const Item& GetItem(unsigned int index) const;
+
+    void SortByState();
+    void SortFrontToBack();
+    void SortBackToFront();
+};
+
+} // NS Renderers
+} // NS OpenEngine
+
+#endif // _OE_RENDER_QUEUE_H_
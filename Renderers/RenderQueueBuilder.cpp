@@ -0,0 +1,114 @@
+// Culling visitor filling a render queue.
+// -------------------------------------------------------------------
+// Copyright (C) 2007 OpenEngine.dk (See AUTHORS)
+//
+// This program is free software; It is covered by the GNU General
+// Public License version 2 or any later version.
+// See the GNU General Public License for more details (see LICENSE).
+//--------------------------------------------------------------------
+
+#include <Renderers/RenderQueueBuilder.h>
+#include <Display/IViewingVolume.h>
+#include <Scene/GeometryNode.h>
+#include <Scene/TransformationNode.h>
+#include <Scene/QuadNode.h>
+#include <Scene/OctNode.h>
+#include <Scene/BSPNode.h>
+
+namespace OpenEngine {
+namespace Renderers {
+
+using namespace OpenEngine::Scene;
+using namespace OpenEngine::Geometry;
+
+// transform a point as a row vector
+static Vector<3,float> Transform(const Vector<3,float>& p,
+                                 const Matrix<4,4,float>& m) {
+    Vector<3,float> r;
+    for (unsigned int j = 0; j < 3; j++)
+        r[j] = p[0] * m(0,j) + p[1] * m(1,j) + p[2] * m(2,j) + m(3,j);
+    return r;
+}
+
+/**
+ * Create a builder, set the viewing volume before building.
+ */
+RenderQueueBuilder::RenderQueueBuilder()
+    : queue(NULL) {
+
+}
+
+RenderQueueBuilder::~RenderQueueBuilder() {
+
+}
+
+/**
+ * Cull a scene into a queue.
+ * The queue is cleared first and filled in scene order.
+ *
+ * @param root Root of the scene.
+ * @param queue Queue to fill.
+ */
+void RenderQueueBuilder::Build(ISceneNode& root, RenderQueue& queue) {
+    queue.Clear();
+    this->queue = &queue;
+    view = GetViewingVolume()->GetViewMatrix();
+    transforms.clear();
+    transforms.push_back(Matrix<4,4,float>());
+    boxes.clear();
+    root.Accept(*this);
+    this->queue = NULL;
+}
+
+/**
+ * Add a geometry node to the queue.
+ *
+ * @param node Geometry node.
+ */
+void RenderQueueBuilder::VisitGeometryNode(GeometryNode* node) {
+    FaceSet* faces = node->GetFaceSet();
+    if (faces && faces->Size() != 0) {
+        RenderQueue::Item item;
+        item.node = node;
+        item.transform = transforms.back();
+        Vector<3,float> center = (boxes.empty())
+            ? Box(*faces).GetCenter() : boxes.back().GetCenter();
+        // the view looks down the negative z axis
+        item.depth = -Transform(Transform(center, item.transform), view)[2];
+        item.state = (*faces->begin())->mat.get();
+        queue->Add(item);
+    }
+    node->VisitSubNodes(*this);
+}
+
+/**
+ * Accumulate a transformation for the sub nodes.
+ *
+ * @param node Transformation node.
+ */
+void RenderQueueBuilder::VisitTransformationNode(TransformationNode* node) {
+    transforms.push_back(node->GetTransformationMatrix() * transforms.back());
+    node->VisitSubNodes(*this);
+    transforms.pop_back();
+}
+
+void RenderQueueBuilder::VisitQuadNode(QuadNode* node) {
+    boxes.push_back(node->GetBoundingBox());
+    AcceleratedRenderingView::VisitQuadNode(node);
+    boxes.pop_back();
+}
+
+void RenderQueueBuilder::VisitOctNode(OctNode* node) {
+    boxes.push_back(node->GetBoundingBox());
+    AcceleratedRenderingView::VisitOctNode(node);
+    boxes.pop_back();
+}
+
+void RenderQueueBuilder::VisitBSPNode(BSPNode* node) {
+    boxes.push_back(node->GetBoundingBox());
+    AcceleratedRenderingView::VisitBSPNode(node);
+    boxes.pop_back();
+}
+
+} // NS Renderers
+} // NS OpenEngine
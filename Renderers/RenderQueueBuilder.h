@@ -0,0 +1,87 @@
+// Culling visitor filling a render queue.
+// -------------------------------------------------------------------
+// Copyright (C) 2007 OpenEngine.dk (See AUTHORS)
+//
+// This program is free software; It is covered by the GNU General
+// Public License version 2 or any later version.
+// See the GNU General Public License for more details (see LICENSE).
+//--------------------------------------------------------------------
+
+#ifndef _OE_RENDER_QUEUE_BUILDER_H_
+#define _OE_RENDER_QUEUE_BUILDER_H_
+
+#include <Renderers/AcceleratedRenderingView.h>
+#include <Renderers/RenderQueue.h>
+#include <Geometry/Box.h>
+#include <vector>
+
+namespace OpenEngine {
+    namespace Scene {
+        class ISceneNode;
+        class GeometryNode;
+        class TransformationNode;
+    }
+namespace Renderers {
+
+using Scene::ISceneNode;
+using Scene::GeometryNode;
+using Scene::TransformationNode;
+
+/**
+ * Culling visitor filling a render queue.
+ *
+ * Culls the acceleration structures of a scene like the
+ * AcceleratedRenderingView, with all its options, but collects the
+ * visible geometry nodes in a RenderQueue instead of rendering them.
+ * Each item holds the transformation accumulated from the
+ * transformation nodes above it and the view depth of the bounds
+ * center of the innermost tree node holding it, or of its own faces
+ * outside trees.
+ *
+ * Building a queue only reads the scene, apart from the culling
+ * hints and leaf pager of the view, so it may run on another thread
+ * than the renderer, for instance into one of two queues swapped
+ * every frame. This does not hold for BSP trees of a lazy build,
+ * which are partitioned as they are traversed. Refine them fully,
+ * until BSPTransformer::Refine returns true, before building queues
+ * on another thread.
+ *
+ * @code
+ * RenderQueueBuilder builder;
+ * builder.SetViewingVolume(viewingVolume);
+ * RenderQueue queue;
+ * // every frame
+ * builder.Build(*scene, queue);
+ * queue.SortByState();
+ * for (unsigned int i = 0; i < queue.GetSize(); i++)
+ *     Draw(queue.GetItem(i));
+ * @endcode
+ *
+ * @see RenderQueue
+ *
+ * @class RenderQueueBuilder RenderQueueBuilder.h Renderers/RenderQueueBuilder.h
+ */
+class RenderQueueBuilder : public AcceleratedRenderingView {
+private:
+    RenderQueue* queue;
+    Matrix<4,4,float> view;
+    std::vector<Matrix<4,4,float> > transforms;
+    std::vector<Geometry::Box> boxes;   //!< bounds of the tree nodes entered
+
+public:
+    RenderQueueBuilder();
+    virtual ~RenderQueueBuilder();
+
+    void Build(ISceneNode& root, RenderQueue& queue);
+
+    void VisitGeometryNode(GeometryNode* node);
+    void VisitTransformationNode(TransformationNode* node);
+    void VisitQuadNode(QuadNode* node);
+    void VisitOctNode(OctNode* node);
+    void VisitBSPNode(BSPNode* node);
+};
+
+} // NS Renderers
+} // NS OpenEngine
+
+#endif // _OE_RENDER_QUEUE_BUILDER_H_
@@ -9,7 +9,9 @@
 
 #include <Scene/ASDotVisitor.h>
 #include <Scene/QuadNode.h>
+#include <Scene/OctNode.h>
 #include <Scene/BSPNode.h>
+#include <Scene/TreeStatistics.h>
 
 namespace OpenEngine {
 namespace Scene {
@@ -46,57 +48,44 @@ void ASDotVisitor::VisitQuadNode(QuadNode* node) {
     node->VisitSubNodes(*this);
 }
 
+void ASDotVisitor::VisitOctNode(OctNode* node) {
+    map<string,string> options;
+    options["shape"] = "box3d";
+    options["label"] = "Oct Node";
+
+    // add this node
+    int nid = GetId(node);
+    dotdata << "{" << nid << " [";
+    for (map<string,string>::iterator op = options.begin(); op != options.end(); op++)
+        dotdata << op->first << "=\"" << op->second << "\" ";
+    dotdata << "]}";
+
+    // bind to sub nodes
+    dotdata << " -> { ";
+    for (unsigned int i = 0; i < 8; i++)
+        if (node->GetChild(i) != NULL)
+            dotdata << GetId(node->GetChild(i)) << "; ";
+    for (list<ISceneNode*>::iterator n = node->subNodes.begin();
+         n != node->subNodes.end(); n++) {
+        dotdata << GetId(*n) << "; ";
+    }
+    dotdata << "};\n";
+
+    // visit sub nodes
+    node->VisitSubNodes(*this);
+}
+
 void ASDotVisitor::VisitBSPNode(BSPNode* node) {    
-    // statistics collector for bsp nodes.
-    class BSPStatsVisitor : public ISceneNodeVisitor {
-    public:
-        int min;                // minimum observed depth
-        int max;                // maximum observed depth
-        int count;              // face count
-        int weight;             // weight in terms of nodes
-        float rel;              // balance relation
-        BSPStatsVisitor() : min(0), max(0), count(0), weight(0), rel(1) {}
-        void VisitBSPNode(BSPNode* node) {
-            int   fmin = 0, bmin = 0;
-            int   fmax = 1, bmax = 1;
-            int   fwgh = 0, bwgh = 0;
-            float frel = 1, brel = 1;
-            if (node->GetFront() != NULL) {
-                node->GetFront()->Accept(*this);
-                fmin = min;
-                fmax = max;
-                frel = rel;
-                fwgh = weight;
-            } else fmin = 1;
-            if (node->GetBack() != NULL) {
-                node->GetBack()->Accept(*this);
-                bmin = min;
-                bmax = max;
-                brel = rel;
-                bwgh = weight;
-            } else bmin = 1;
-            if (fmin == 0 || bmin == 0) min = ((fmin>bmin) ? fmin : bmin) + 1;
-            else min = ((fmin<bmin) ? fmin : bmin) + 1;
-            max = ((fmax>bmax) ? fmax : bmax) + 1;
-            rel = frel * brel + 0.1f;
-            if (fwgh != 0 && bwgh != 0)
-                rel *= (fwgh<bwgh) ? (float)fwgh/(float)bwgh : (float)bwgh/(float)fwgh;
-            if (node->GetSpan() != NULL)
-                count += 1 + node->GetSpan()->Size();
-            weight = fwgh + bwgh + 1;
-        }
-    };
-    // create sub visitor for statistics gathering.
-    BSPStatsVisitor stats;
-    stats.VisitBSPNode(node);
+    TreeStatistics stats;
+    stats.Collect(node);
     // create the dot node
     ostringstream label;
     label << "BSP Tree\\n"
-          << "Face count: "  << stats.count  << "\\n"
-          << "Tree weight: " << stats.weight << "\\n"
-          << "Relation: "    << stats.rel    << "\\n"
-          << "Min depth: "   << stats.min    << "\\n"
-          << "Max depth: "   << stats.max;
+          << "Face count: "  << stats.faces  << "\\n"
+          << "Tree weight: " << stats.nodes  << "\\n"
+          << "Relation: "    << stats.balance << "\\n"
+          << "Min depth: "   << stats.minDepth << "\\n"
+          << "Max depth: "   << stats.maxDepth;
     map<string,string> options;
     options["shape"] = "triangle";
     options["label"] = label.str();
@@ -23,6 +23,7 @@ namespace Scene {
 class ASDotVisitor : public DotVisitor {
 public:
     virtual void VisitQuadNode(QuadNode* node);
+    virtual void VisitOctNode(OctNode* node);
     virtual void VisitBSPNode(BSPNode* node);
 };
 
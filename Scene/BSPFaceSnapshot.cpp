@@ -0,0 +1,276 @@
+// Structure of arrays vertex snapshot of a face set.
+// -------------------------------------------------------------------
+// Copyright (C) 2007 OpenEngine.dk (See AUTHORS) 
+// 
+// This program is free software; It is covered by the GNU General 
+// Public License version 2 or any later version. 
+// See the GNU General Public License for more details (see LICENSE). 
+//--------------------------------------------------------------------
+
+#include <Scene/BSPFaceSnapshot.h>
+#include <Scene/BSPPlaneCache.h>
+
+#if defined(__AVX__)
+#include <immintrin.h>
+#elif defined(__SSE__)
+#include <xmmintrin.h>
+#endif
+
+namespace OpenEngine {
+namespace Scene {
+
+// number of set bits in the lower byte
+static inline unsigned int BitCount(unsigned int v) {
+    v = v - ((v >> 1) & 0x55);
+    v = (v & 0x33) + ((v >> 2) & 0x33);
+    return (v + (v >> 4)) & 0x0f;
+}
+
+/**
+ * Create a snapshot of a face set.
+ *
+ * @param faces Face set to copy the vertices of.
+ * @param cache Optional plane cache to take the plane ids from.
+ */
+BSPFaceSnapshot::BSPFaceSnapshot(FaceSet& faces, const BSPPlaneCache* cache) {
+    Reserve(faces.Size());
+    for (FaceList::iterator itr = faces.begin(); itr != faces.end(); itr++) {
+        unsigned int id;
+        if (!cache || !cache->Lookup(itr->get(), id)) id = NO_PLANE;
+        Append(&(*itr), MakePlane(**itr), id);
+    }
+}
+
+/**
+ * Create a snapshot of a subset of another snapshot.
+ *
+ * @param source Snapshot to pick faces from.
+ * @param indices Indices of the faces in \a source to pick.
+ */
+BSPFaceSnapshot::BSPFaceSnapshot(const BSPFaceSnapshot& source,
+                                 const std::vector<unsigned int>& indices) {
+    Reserve(indices.size());
+    for (unsigned int i = 0; i < indices.size(); i++)
+        Append(source.faces[indices[i]], source.planes[indices[i]],
+               source.ids[indices[i]]);
+}
+
+/**
+ * Create a snapshot of indexed faces of an array.
+ * The snapshot refers to the faces in the array, which must not be
+ * resized while the snapshot is in use.
+ *
+ * @param faces Face array.
+ * @param indices Indices of the faces to pick.
+ * @param count Number of indices.
+ * @param cache Optional plane cache to take the plane ids from.
+ */
+BSPFaceSnapshot::BSPFaceSnapshot(const std::vector<FacePtr>& faces,
+                                 const unsigned int* indices, unsigned int count,
+                                 const BSPPlaneCache* cache) {
+    Reserve(count);
+    for (unsigned int i = 0; i < count; i++) {
+        const FacePtr* face = &faces[indices[i]];
+        unsigned int id;
+        if (!cache || !cache->Lookup(face->get(), id)) id = NO_PLANE;
+        Append(face, MakePlane(**face), id);
+    }
+}
+
+void BSPFaceSnapshot::Reserve(unsigned int size) {
+    faces.reserve(size);
+    planes.reserve(size);
+    ids.reserve(size);
+    for (unsigned int i = 0; i < 9; i++)
+        coords[i].reserve(size);
+}
+
+void BSPFaceSnapshot::Append(const FacePtr* face, const BSPPlane& plane,
+                             unsigned int id) {
+    faces.push_back(face);
+    planes.push_back(plane);
+    ids.push_back(id);
+    for (unsigned int v = 0; v < 3; v++)
+        for (unsigned int c = 0; c < 3; c++)
+            coords[v*3+c].push_back((*face)->vert[v][c]);
+}
+
+/**
+ * Get the number of faces in the snapshot.
+ *
+ * @return Face count.
+ */
+unsigned int BSPFaceSnapshot::Size() const {
+    return faces.size();
+}
+
+/**
+ * Get a face of the snapshot.
+ *
+ * @param index Index of the face.
+ * @return Face in the source set.
+ */
+const FacePtr& BSPFaceSnapshot::GetFace(unsigned int index) const {
+    return *faces[index];
+}
+
+/**
+ * Get the plane of a face of the snapshot.
+ * This is the exact plane of the face, also for faces sharing a plane
+ * id, so a partition by it agrees with Face::ComparePointPlane.
+ *
+ * @param index Index of the face.
+ * @return Plane of the face.
+ */
+const BSPPlane& BSPFaceSnapshot::GetPlane(unsigned int index) const {
+    return planes[index];
+}
+
+/**
+ * Get the plane id of a face of the snapshot.
+ * Faces with the same id are coplanar within the tolerance of the
+ * plane cache, so only one of them needs to be scored as a divider.
+ *
+ * @param index Index of the face.
+ * @return Plane id, NO_PLANE if the face was not in the plane cache.
+ */
+unsigned int BSPFaceSnapshot::GetPlaneId(unsigned int index) const {
+    return ids[index];
+}
+
+/**
+ * Get the axis aligned bounds of all vertices in the snapshot.
+ *
+ * @pre The snapshot is non-empty.
+ * @param[out] lo Minimum corner.
+ * @param[out] hi Maximum corner.
+ */
+void BSPFaceSnapshot::GetBounds(Vector<3,float>& lo, Vector<3,float>& hi) const {
+    for (unsigned int c = 0; c < 3; c++) {
+        lo[c] = hi[c] = coords[c][0];
+        for (unsigned int v = 0; v < 3; v++) {
+            const std::vector<float>& a = coords[v*3+c];
+            for (unsigned int i = 0; i < a.size(); i++) {
+                if (a[i] < lo[c]) lo[c] = a[i];
+                if (a[i] > hi[c]) hi[c] = a[i];
+            }
+        }
+    }
+}
+
+/**
+ * Get the plane of a face, as used by Face::ComparePointPlane.
+ *
+ * @param face Face to get the plane of.
+ * @return Plane through the first vertex with the face normal.
+ */
+BSPPlane BSPFaceSnapshot::MakePlane(const Face& face) {
+    BSPPlane p;
+    p.a = face.hardNorm[0];
+    p.b = face.hardNorm[1];
+    p.c = face.hardNorm[2];
+    p.d = p.a * face.vert[0][0] + p.b * face.vert[0][1] + p.c * face.vert[0][2];
+    return p;
+}
+
+/**
+ * Classify all faces of the snapshot against a plane.
+ *
+ * @param plane Plane to classify by.
+ * @param epsilon Distance within which a vertex is in the plane.
+ * @param[out] sides Optional array receiving the BSPSide of each face.
+ * @return Face counts of each side.
+ */
+BSPClassification BSPFaceSnapshot::Classify(const BSPPlane& plane, float epsilon,
+                                            unsigned char* sides) const {
+    BSPClassification cls = { 0, 0, 0, 0 };
+    const unsigned int size = faces.size();
+    if (size == 0) return cls;
+    const float* x0 = &coords[0][0]; const float* y0 = &coords[1][0]; const float* z0 = &coords[2][0];
+    const float* x1 = &coords[3][0]; const float* y1 = &coords[4][0]; const float* z1 = &coords[5][0];
+    const float* x2 = &coords[6][0]; const float* y2 = &coords[7][0]; const float* z2 = &coords[8][0];
+    unsigned int i = 0;
+
+#if defined(__AVX__)
+    const __m256 a = _mm256_set1_ps(plane.a), b = _mm256_set1_ps(plane.b);
+    const __m256 c = _mm256_set1_ps(plane.c), d = _mm256_set1_ps(plane.d);
+    const __m256 pe = _mm256_set1_ps(epsilon), ne = _mm256_set1_ps(-epsilon);
+    for (; i + 8 <= size; i += 8) {
+#define OE_BSP_DIST(x,y,z)                                              \
+        _mm256_sub_ps(_mm256_add_ps(_mm256_add_ps(                      \
+            _mm256_mul_ps(a, _mm256_loadu_ps(x+i)),                     \
+            _mm256_mul_ps(b, _mm256_loadu_ps(y+i))),                    \
+            _mm256_mul_ps(c, _mm256_loadu_ps(z+i))), d)
+        __m256 d0 = OE_BSP_DIST(x0,y0,z0);
+        __m256 d1 = OE_BSP_DIST(x1,y1,z1);
+        __m256 d2 = OE_BSP_DIST(x2,y2,z2);
+#undef OE_BSP_DIST
+        unsigned int fm = _mm256_movemask_ps
+            (_mm256_or_ps(_mm256_or_ps(_mm256_cmp_ps(d0, pe, _CMP_GT_OQ),
+                                       _mm256_cmp_ps(d1, pe, _CMP_GT_OQ)),
+                          _mm256_cmp_ps(d2, pe, _CMP_GT_OQ)));
+        unsigned int bm = _mm256_movemask_ps
+            (_mm256_or_ps(_mm256_or_ps(_mm256_cmp_ps(d0, ne, _CMP_LT_OQ),
+                                       _mm256_cmp_ps(d1, ne, _CMP_LT_OQ)),
+                          _mm256_cmp_ps(d2, ne, _CMP_LT_OQ)));
+        cls.span     += BitCount(fm & bm);
+        cls.front    += BitCount(fm & ~bm);
+        cls.back     += BitCount(bm & ~fm);
+        cls.coplanar += BitCount(~(fm | bm) & 0xff);
+        if (sides)
+            for (unsigned int k = 0; k < 8; k++)
+                sides[i+k] = ((fm >> k) & 1) | (((bm >> k) & 1) << 1);
+    }
+#elif defined(__SSE__)
+    const __m128 a = _mm_set1_ps(plane.a), b = _mm_set1_ps(plane.b);
+    const __m128 c = _mm_set1_ps(plane.c), d = _mm_set1_ps(plane.d);
+    const __m128 pe = _mm_set1_ps(epsilon), ne = _mm_set1_ps(-epsilon);
+    for (; i + 4 <= size; i += 4) {
+#define OE_BSP_DIST(x,y,z)                                      \
+        _mm_sub_ps(_mm_add_ps(_mm_add_ps(                       \
+            _mm_mul_ps(a, _mm_loadu_ps(x+i)),                   \
+            _mm_mul_ps(b, _mm_loadu_ps(y+i))),                  \
+            _mm_mul_ps(c, _mm_loadu_ps(z+i))), d)
+        __m128 d0 = OE_BSP_DIST(x0,y0,z0);
+        __m128 d1 = OE_BSP_DIST(x1,y1,z1);
+        __m128 d2 = OE_BSP_DIST(x2,y2,z2);
+#undef OE_BSP_DIST
+        unsigned int fm = _mm_movemask_ps
+            (_mm_or_ps(_mm_or_ps(_mm_cmpgt_ps(d0, pe), _mm_cmpgt_ps(d1, pe)),
+                       _mm_cmpgt_ps(d2, pe)));
+        unsigned int bm = _mm_movemask_ps
+            (_mm_or_ps(_mm_or_ps(_mm_cmplt_ps(d0, ne), _mm_cmplt_ps(d1, ne)),
+                       _mm_cmplt_ps(d2, ne)));
+        cls.span     += BitCount(fm & bm);
+        cls.front    += BitCount(fm & ~bm);
+        cls.back     += BitCount(bm & ~fm);
+        cls.coplanar += BitCount(~(fm | bm) & 0x0f);
+        if (sides)
+            for (unsigned int k = 0; k < 4; k++)
+                sides[i+k] = ((fm >> k) & 1) | (((bm >> k) & 1) << 1);
+    }
+#endif
+
+    // scalar fallback and remainder
+    for (; i < size; i++) {
+        float d0 = plane.a*x0[i] + plane.b*y0[i] + plane.c*z0[i] - plane.d;
+        float d1 = plane.a*x1[i] + plane.b*y1[i] + plane.c*z1[i] - plane.d;
+        float d2 = plane.a*x2[i] + plane.b*y2[i] + plane.c*z2[i] - plane.d;
+        unsigned char side = 0;
+        if (d0 > epsilon || d1 > epsilon || d2 > epsilon)
+            side |= BSP_FRONT;
+        if (d0 < -epsilon || d1 < -epsilon || d2 < -epsilon)
+            side |= BSP_BACK;
+        switch (side) {
+        case BSP_FRONT:    ++cls.front;    break;
+        case BSP_BACK:     ++cls.back;     break;
+        case BSP_SPANNING: ++cls.span;     break;
+        default:           ++cls.coplanar; break;
+        }
+        if (sides) sides[i] = side;
+    }
+    return cls;
+}
+
+} // NS Scene
+} // NS OpenEngine
@@ -0,0 +1,108 @@
+// Structure of arrays vertex snapshot of a face set.
+// -------------------------------------------------------------------
+// Copyright (C) 2007 OpenEngine.dk (See AUTHORS) 
+// 
+// This program is free software; It is covered by the GNU General 
+// Public License version 2 or any later version. 
+// See the GNU General Public License for more details (see LICENSE). 
+//--------------------------------------------------------------------
+
+#ifndef _OE_BSP_FACE_SNAPSHOT_H_
+#define _OE_BSP_FACE_SNAPSHOT_H_
+
+#include <Geometry/FaceSet.h>
+#include <vector>
+
+namespace OpenEngine {
+namespace Scene {
+
+class BSPPlaneCache;
+
+using namespace OpenEngine::Geometry;
+
+/**
+ * Plane in the form a*x + b*y + c*z = d.
+ */
+struct BSPPlane {
+    float a, b, c, d;
+};
+
+//! Position of a face relative to a plane.
+enum BSPSide {
+    BSP_COPLANAR = 0,   //!< all vertices in the plane
+    BSP_FRONT    = 1,   //!< in front of the plane
+    BSP_BACK     = 2,   //!< behind the plane
+    BSP_SPANNING = 3    //!< vertices on both sides of the plane
+};
+
+/**
+ * Face counts of a plane classification.
+ */
+struct BSPClassification {
+    unsigned int front;     //!< faces in front of the plane
+    unsigned int back;      //!< faces behind the plane
+    unsigned int span;      //!< faces straddling the plane
+    unsigned int coplanar;  //!< faces in the plane
+};
+
+/**
+ * Structure of arrays vertex snapshot of a face set.
+ *
+ * The vertex coordinates of all faces are copied into one float
+ * array per vertex and coordinate, so all faces can be classified
+ * against a plane in a single vectorized pass. Where the compiler
+ * targets AVX or SSE the kernel classifies eight or four faces at a
+ * time, otherwise it falls back to scalar code.
+ *
+ * A face is classified as Face::ComparePosition would: it is in front
+ * if no vertex is behind the plane, behind if no vertex is in front,
+ * spanning if vertices are on both sides, and coplanar if all
+ * vertices are within epsilon of the plane.
+ *
+ * With a BSPPlaneCache the faces get the plane ids of the cache, so
+ * divider strategies can skip faces coplanar with one already scored
+ * without comparing planes. The planes themselves are always the
+ * exact planes of the faces.
+ *
+ * The snapshot refers to the faces of the source face set and must
+ * not outlive it.
+ *
+ * @class BSPFaceSnapshot BSPFaceSnapshot.h Scene/BSPFaceSnapshot.h
+ */
+class BSPFaceSnapshot {
+private:
+    std::vector<const FacePtr*> faces; //!< faces of the source set
+    std::vector<float> coords[9];      //!< x, y and z of each vertex
+    std::vector<BSPPlane> planes;      //!< plane of each face
+    std::vector<unsigned int> ids;     //!< plane id of each face
+
+    void Reserve(unsigned int size);
+    void Append(const FacePtr* face, const BSPPlane& plane, unsigned int id);
+
+public:
+    //! Plane id of faces without a cached plane.
+    static const unsigned int NO_PLANE = ~0u;
+
+    explicit BSPFaceSnapshot(FaceSet& faces, const BSPPlaneCache* cache = NULL);
+    BSPFaceSnapshot(const BSPFaceSnapshot& source,
+                    const std::vector<unsigned int>& indices);
+    BSPFaceSnapshot(const std::vector<FacePtr>& faces,
+                    const unsigned int* indices, unsigned int count,
+                    const BSPPlaneCache* cache = NULL);
+
+    unsigned int Size() const;
+    const FacePtr& GetFace(unsigned int index) const;
+    const BSPPlane& GetPlane(unsigned int index) const;
+    unsigned int GetPlaneId(unsigned int index) const;
+    void GetBounds(Vector<3,float>& lo, Vector<3,float>& hi) const;
+
+    BSPClassification Classify(const BSPPlane& plane, float epsilon,
+                               unsigned char* sides = NULL) const;
+
+    static BSPPlane MakePlane(const Face& face);
+};
+
+} // NS Scene
+} // NS OpenEngine
+
+#endif // _OE_BSP_FACE_SNAPSHOT_H_
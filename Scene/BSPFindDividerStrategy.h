@@ -10,12 +10,19 @@
 #ifndef _BSP_FIND_DIVIDER_STRATEGY_H_
 #define _BSP_FIND_DIVIDER_STRATEGY_H_
 
+#include <Scene/BSPFaceSnapshot.h>
+#include <vector>
+#include <set>
+
 namespace OpenEngine {
 namespace Scene {
 
 /**
  * Short description.
  *
+ * Strategies may be used by several build threads at once and must
+ * not keep state between calls.
+ *
  * @class BSPFindDividerStrategy BSPFindDividerStrategy.h Scene/BSPFindDividerStrategy.h
  */
 class BSPFindDividerStrategy {
@@ -34,86 +41,248 @@ public:
      * @return Dividing face.
      */
     virtual FacePtr FindDivider(FaceSet& faces, float epsilon = EPS) = 0;
+
+    /**
+     * Find a dividing face in a vertex snapshot.
+     *
+     * The default implementation copies the snapshot to a face set
+     * and calls FindDivider. Strategies that score candidates should
+     * override it to classify with BSPFaceSnapshot::Classify.
+     *
+     * @pre faces is non-empty.
+     * @param faces Snapshot in which to search for divider.
+     * @param epsilon Epsilon value.
+     * @return Index of the dividing face in the snapshot.
+     */
+    virtual unsigned int SelectDivider(const BSPFaceSnapshot& faces,
+                                       float epsilon = EPS) {
+        FaceSet set;
+        for (unsigned int i = 0; i < faces.Size(); i++)
+            set.Add(faces.GetFace(i));
+        FacePtr divider = FindDivider(set, epsilon);
+        for (unsigned int i = 0; i < faces.Size(); i++)
+            if (faces.GetFace(i) == divider) return i;
+        throw Exception("Divider strategy returned a face not in the set.");
+    }
+
+protected:
+    /**
+     * Check if a plane has already been scored and mark it as scored.
+     * Faces without a cached plane are never skipped.
+     *
+     * @param id Plane id of the candidate.
+     * @param scored Plane ids scored so far.
+     * @return True if the candidate can be skipped.
+     */
+    static bool Scored(unsigned int id, std::set<unsigned int>& scored) {
+        if (id == BSPFaceSnapshot::NO_PLANE) return false;
+        return !scored.insert(id).second;
+    }
+
+    /**
+     * Compute the balance relation between the front and back sets.
+     *
+     * @param cls Classification to compute the relation of.
+     * @return Relation in [0;1], 0 if one of the sets is empty.
+     */
+    static float Relation(const BSPClassification& cls) {
+        if (cls.front * cls.back == 0)
+            return 0;
+        else if (cls.front < cls.back)
+            return (float)cls.front / (float)cls.back;
+        else
+            return (float)cls.back / (float)cls.front;
+    }
 };
 
 
 /**
  * Find the best dividing face in the set.
  *
+ * Every face is scored against all faces of the set by classifying
+ * the set against its plane with BSPFaceSnapshot::Classify. The face
+ * splitting the fewest faces is chosen, and among those the one with
+ * the best balance relation. Faces sharing a cached plane are only
+ * scored once.
+ *
  * This algorithm is based on the choose-dividing-polygon listing
  * found at http://www.devmaster.net/articles/bsp-trees/
  */
 class BSPDefaultFindDivider : public BSPFindDividerStrategy {
 public:
     virtual FacePtr FindDivider(FaceSet& faces, float epsilon = EPS) {
-        // adjustable constants
-        float relation_minimum = 0.0; // initial minimum balance relation
-        float relation_scale   = 0.5; // scale to lower the relation with
-        // other declarations
-        FaceList::iterator best_face = faces.end();
-        int min_split = faces.Size();
-        float best_rel = 0.0;
-        float cur_rel = 0.0;
-        int no_front, no_back, no_span;
-        FaceList::iterator ftest, fcomp;
-        Vector<3,int> pos;
         // if the set is empty return
-        if (min_split == 0)
+        if (faces.Size() == 0)
+            throw Exception("Invalid call to find divider with an empty face set.");
+        // if only one element is in the set it as best
+        if (faces.Size() == 1) return *faces.begin();
+        BSPFaceSnapshot snapshot(faces);
+        return snapshot.GetFace(SelectDivider(snapshot, epsilon));
+    }
+
+    virtual unsigned int SelectDivider(const BSPFaceSnapshot& faces,
+                                       float epsilon = EPS) {
+        unsigned int best_face = 0;
+        unsigned int min_split = faces.Size() + 1;
+        float best_rel = -1;
+        std::set<unsigned int> scored;
+        for (unsigned int ftest = 0; ftest < faces.Size(); ftest++) {
+            if (Scored(faces.GetPlaneId(ftest), scored)) continue;
+            BSPClassification cls = faces.Classify(faces.GetPlane(ftest), epsilon);
+            float cur_rel = Relation(cls);
+            // if the face we are testing is the best seen save it
+            if (cls.span < min_split ||
+                (cls.span == min_split && cur_rel > best_rel)) {
+                best_face = ftest;
+                min_split = cls.span;
+                best_rel  = cur_rel;
+            }
+        }
+        return best_face;
+    }
+};
+
+/**
+ * Find a good dividing face from a bounded sample of candidates.
+ *
+ * Where BSPDefaultFindDivider tests every face against every other
+ * face, this strategy only evaluates a fixed number of candidate
+ * faces per node. Each candidate is scored against the full face set,
+ * or optionally against a sampled subset of it, by the same criteria
+ * as the default strategy: fewest spanning faces first and then the
+ * best balance relation between the front and back sets.
+ *
+ * Candidates are picked either uniformly at random or stratified,
+ * that is one random face from each of \a candidates equally sized
+ * runs of the face set.
+ *
+ * The sampling sequence is seeded from the seed and the size of the
+ * face set, so the strategy keeps no state between calls and builds
+ * are reproducible.
+ *
+ * @code
+ * BSPTransformer bspt;
+ * // score 16 stratified candidates against at most 1000 faces
+ * bspt.SetFindDividerStrategy
+ *     (new BSPSampledFindDivider(16, BSPSampledFindDivider::STRATIFIED, 1000));
+ * @endcode
+ */
+class BSPSampledFindDivider : public BSPFindDividerStrategy {
+public:
+    //! Candidate sampling modes.
+    enum SampleMode {
+        RANDOM,     //!< uniformly random candidates
+        STRATIFIED  //!< one random candidate per run of the face set
+    };
+
+private:
+    unsigned int candidates;   //!< number of candidates per node
+    SampleMode mode;           //!< candidate sampling mode
+    unsigned int scoreSamples; //!< faces to score against, 0 is all
+    unsigned int seed;         //!< sampling seed
+
+    static unsigned int Next(unsigned int& state) {
+        state = state * 1664525 + 1013904223;
+        return state >> 8;
+    }
+
+    /**
+     * Pick \a count indices out of \a size into \a out.
+     * If \a count is not less than \a size all indices are picked.
+     */
+    void Sample(unsigned int size, unsigned int count,
+                unsigned int& state, std::vector<unsigned int>& out) {
+        out.clear();
+        if (count == 0 || count >= size) {
+            for (unsigned int i = 0; i < size; i++)
+                out.push_back(i);
+            return;
+        }
+        out.reserve(count);
+        if (mode == STRATIFIED) {
+            for (unsigned int i = 0; i < count; i++) {
+                unsigned int first = (unsigned int)
+                    ((unsigned long long)i * size / count);
+                unsigned int last = (unsigned int)
+                    ((unsigned long long)(i+1) * size / count);
+                out.push_back(first + Next(state) % (last - first));
+            }
+        } else {
+            // partial fisher-yates shuffle over the indices
+            std::vector<unsigned int> all(size);
+            for (unsigned int i = 0; i < size; i++)
+                all[i] = i;
+            for (unsigned int i = 0; i < count; i++) {
+                unsigned int j = i + Next(state) % (size - i);
+                unsigned int tmp = all[i];
+                all[i] = all[j];
+                all[j] = tmp;
+                out.push_back(all[i]);
+            }
+        }
+    }
+
+public:
+    /**
+     * Create a sampled divider strategy.
+     *
+     * @param candidates Number of candidate faces evaluated per node.
+     * @param mode Candidate sampling mode.
+     * @param scoreSamples Number of faces each candidate is scored
+     *                     against, zero to score against all faces.
+     * @param seed Seed for the sampling sequence.
+     */
+    BSPSampledFindDivider(unsigned int candidates = 32,
+                          SampleMode mode = STRATIFIED,
+                          unsigned int scoreSamples = 0,
+                          unsigned int seed = 0)
+        : candidates(candidates)
+        , mode(mode)
+        , scoreSamples(scoreSamples)
+        , seed(seed) {}
+
+    virtual FacePtr FindDivider(FaceSet& faces, float epsilon = EPS) {
+        // if the set is empty return
+        if (faces.Size() == 0)
             throw Exception("Invalid call to find divider with an empty face set.");
         // if only one element is in the set it as best
-        if (min_split == 1) best_face = faces.begin();
-        // find the best face in the set
-        while (best_face == faces.end()) {
-            for (ftest = faces.begin(); ftest != faces.end(); ftest++) {
-                no_front = no_back = no_span = 0;
-                for (fcomp = faces.begin(); fcomp != faces.end(); fcomp++) {
-                    // ignore the face we are testing
-                    if (*fcomp == *ftest) continue;
-                    // count the face positions
-                    pos = (*ftest)->ComparePosition(*fcomp, epsilon);
-                    switch (pos.Sum()) {
-                    case -3:
-                    case -2:
-                        ++no_back; break;
-                    case 3:
-                    case 2:
-                        ++no_front; break;
-                    case -1:
-                        if (pos[0] * pos[1] * pos[2] == 0) ++no_back;
-                        else ++no_span;
-                        break;
-                    case 1:
-                        if (pos[0] * pos[1] * pos[2] == 0) ++no_front;
-                        else ++no_span;
-                        break;
-                    case 0:
-                        if (pos[0] || pos[1] || pos[2]) ++no_span;
-                        // else it is in the same plane and we don't care
-                        break;
-                    }
-                    // compute the division relation
-                    if (no_front * no_back == 0)
-                        cur_rel = 0;
-                    else if (no_front < no_back)
-                        cur_rel = (float)no_front / (float)no_back;
-                    else if (no_back < no_front)
-                        cur_rel = (float)no_back / (float)no_front;
-                    else
-                        cur_rel = 1;
-                    // if the face we are testing is the best seen save it
-                    if (cur_rel >= relation_minimum &&
-                        (no_span  < min_split ||
-                         (no_span == min_split && cur_rel > best_rel))) {
-                        best_face = ftest;
-                        min_split = no_span;
-                        best_rel  = cur_rel;
-                    }
-                }
+        if (faces.Size() == 1) return *faces.begin();
+        BSPFaceSnapshot snapshot(faces);
+        return snapshot.GetFace(SelectDivider(snapshot, epsilon));
+    }
+
+    virtual unsigned int SelectDivider(const BSPFaceSnapshot& faces,
+                                       float epsilon = EPS) {
+        unsigned int size = faces.Size();
+        std::vector<unsigned int> cands, scored;
+        unsigned int state = seed ^ (size * 2654435761u);
+        Sample(size, candidates, state, cands);
+        Sample(size, scoreSamples, state, scored);
+
+        // score against a sub snapshot if only a subset is sampled
+        BSPFaceSnapshot* subset = NULL;
+        if (scored.size() < size)
+            subset = new BSPFaceSnapshot(faces, scored);
+        const BSPFaceSnapshot& target = (subset) ? *subset : faces;
+
+        unsigned int best_face = cands[0];
+        unsigned int min_split = size + 1;
+        float best_rel = -1;
+        std::set<unsigned int> planes;
+        for (unsigned int i = 0; i < cands.size(); i++) {
+            if (Scored(faces.GetPlaneId(cands[i]), planes)) continue;
+            BSPClassification cls = target.Classify(faces.GetPlane(cands[i]), epsilon);
+            float cur_rel = Relation(cls);
+            // if the face we are testing is the best seen save it
+            if (cls.span < min_split ||
+                (cls.span == min_split && cur_rel > best_rel)) {
+                best_face = cands[i];
+                min_split = cls.span;
+                best_rel  = cur_rel;
             }
-            // lower the scale factor
-            relation_minimum *= relation_scale - .01;
         }
-        return *best_face;
+        delete subset;
+        return best_face;
     }
 };
     
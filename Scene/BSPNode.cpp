@@ -18,13 +18,31 @@ namespace Scene {
 
 /**
  * Copy constructor.
- * Performs a shallow copy.
+ * Performs a shallow copy, the faces are shared with \a node.
+ * The copy is always heap allocated, also if \a node is in an arena.
  *
  * @param node Node to copy.
  */
 BSPNode::BSPNode(const BSPNode& node)
     : ISceneNode(node)
+    , divider(node.divider)
+    , front(NULL)
+    , back(NULL)
+    , bb(node.bb)
+    , pooled(false)
+    , count(node.count)
+    , balance(node.balance)
+    , pending(NULL)
+    , builder(node.builder)
+    , depth(node.depth)
+    , hint(0)
 {
+    if (node.pending) {
+        pending = new FaceSet(*node.pending);
+        sub = NULL;
+        span = NULL;
+        return;
+    }
     sub  = (GeometryNode*)node.sub->Clone();
     span = sub->GetFaceSet();
     if (node.front) front = (BSPNode*)node.front->Clone();
@@ -32,6 +50,8 @@ BSPNode::BSPNode(const BSPNode& node)
 }
 
 void BSPNode::Serialize(Resources::IArchiveWriter& w) {
+    Refine();
+    // leaves are written with a NULL divider, as in the original format
     w.WriteObjectPtr("divider",divider);
     if (front) {
         w.WriteInt("e",1);
@@ -73,12 +93,53 @@ void BSPNode::Deserialize(Resources::IArchiveReader& r) {
     
     //back = dynamic_cast<BSPNode*>(r.ReadScene("back"));
 
-    span = new FaceSet();
+    FaceSet* faces = new FaceSet();
     size_t len = r.ReadInt("span");
     while (len--)
-        span->Add(r.ReadObjectPtr<Face>("face"));
+        faces->Add(r.ReadObjectPtr<Face>("face"));
 
+    // the span set is owned by the sub node
     sub = dynamic_cast<GeometryNode*>(r.ReadScene("sub"));
+    if (sub) {
+        span = sub->GetFaceSet();
+        delete faces;
+    } else {
+        span = faces;
+        sub = new GeometryNode(span);
+    }
+
+    // the children are read, so the bounds can be built bottom up
+    ComputeBoundingBox();
+    unsigned int fcount = (front) ? front->count : 0;
+    unsigned int bcount = (back)  ? back->count  : 0;
+    count = span->Size() + fcount + bcount;
+    if (fcount * bcount == 0) balance = 0;
+    else balance = (fcount < bcount) ? (float)fcount / bcount : (float)bcount / fcount;
+}
+
+/**
+ * Compute the bounding box from the span set and the bounding boxes
+ * of the front and back nodes.
+ */
+void BSPNode::ComputeBoundingBox() {
+    Vector<3,float> lo, hi;
+    bool empty = true;
+    Box boxes[3];
+    unsigned int count = 0;
+    if (span && span->Size() > 0) boxes[count++] = Box(*span);
+    if (front) boxes[count++] = front->GetBoundingBox();
+    if (back)  boxes[count++] = back->GetBoundingBox();
+    for (unsigned int i = 0; i < count; i++) {
+        Vector<3,float> c = boxes[i].GetCenter();
+        Vector<3,float> r = boxes[i].GetCorner();
+        for (unsigned int j = 0; j < 3; j++) {
+            if (empty || c[j] - r[j] < lo[j]) lo[j] = c[j] - r[j];
+            if (empty || c[j] + r[j] > hi[j]) hi[j] = c[j] + r[j];
+        }
+        empty = false;
+    }
+    if (!empty)
+        bb = Box((lo + hi) * 0.5f, (hi - lo) * 0.5f);
 }
 
 
@@ -87,7 +148,12 @@ void BSPNode::Deserialize(Resources::IArchiveReader& r) {
  * 
  * 1. Finds best dividing plane.
  * 2. Creates front-set and back-set with split.
- * 3. Recursively creates front node and back node from the sets.
+ * 3. Creates front node and back node from the sets.
+ *
+ * The construction is performed by BSPTransformer::Build, which
+ * honors the depth, leaf size and time budgets of the transformer.
+ * If the transformer has a NodeArena the sub nodes are allocated
+ * from it.
  *
  * No local reference is kept to the parameter \a faces and it is the
  * callers responsibility to delete it if necessary.
@@ -99,38 +165,31 @@ void BSPNode::Deserialize(Resources::IArchiveReader& r) {
  * @see BSPTransformer
  */
 BSPNode::BSPNode(BSPTransformer& trans, FaceSet* faces)
-    : front(NULL), back(NULL), span(NULL) {
-
-    // create face sets
-    span = new FaceSet();
-    FaceSet* fset = new FaceSet();
-    FaceSet* bset = new FaceSet();
-
-    // wrap the spanning set with a geometry node (for traversal)
-    sub = new GeometryNode(span);
-
-    // find divider
-    divider = trans.GetFindDividerStrategy()->FindDivider(*faces, epsilon);
-
-    // partition to the sets
-    trans.GetPartitionStrategy()->Partition(divider, *faces, *fset, *span, *bset, epsilon);
-
-    // create sub nodes
-    if (fset->Size() > 0)
-        front = new BSPNode(trans, fset);
-    if (bset->Size() > 0)
-        back = new BSPNode(trans, bset);
-    
-    // delete the unused face sets
-    delete fset;
-    delete bset;
+    : front(NULL), back(NULL), span(NULL), sub(NULL)
+    , pooled(trans.GetNodeArena() != NULL), count(0), balance(0)
+    , pending(NULL), builder(NULL), depth(0), hint(0) {
+    trans.Build(*this, faces);
 }
 
 /**
  * Destructor.
+ * Deletes the sub tree, unless it is owned by a NodeArena, the
+ * geometry node of the span set and the faces of a lazy node.
  */
 BSPNode::~BSPNode() {
+    if (!pooled) {
+        delete front;
+        delete back;
+    }
+    delete sub;
+    delete pending;
+}
 
+/**
+ * Partition the faces of a lazy node with its transformer.
+ */
+void BSPNode::Expand() {
+    builder->Refine(*this);
 }
 
 /**
@@ -141,6 +200,7 @@ BSPNode::~BSPNode() {
  * @param visitor Current visitor.
  */
 void BSPNode::VisitSubNodes(ISceneNodeVisitor& visitor) {
+    Refine();
     list<ISceneNode*>::iterator itr;
     if (GetFront() != NULL )
         GetFront()->Accept(visitor);
@@ -157,6 +217,7 @@ void BSPNode::VisitSubNodes(ISceneNodeVisitor& visitor) {
  * @return Node with front faces, NULL if no front set exists
  */
 BSPNode* BSPNode::GetFront() {
+    Refine();
     return front;
 }
 
@@ -166,6 +227,7 @@ BSPNode* BSPNode::GetFront() {
  * @return Node with back faces, NULL if no back set exists
  */
 BSPNode* BSPNode::GetBack() {
+    Refine();
     return back;
 }
 
@@ -175,18 +237,92 @@ BSPNode* BSPNode::GetBack() {
  * @return Face set of faces in the divider plane
  */
 FaceSet* BSPNode::GetSpan() {
+    Refine();
     return span;
 }
 
+/**
+ * Get the geometry node wrapping the faces in the divider plane.
+ *
+ * @return Geometry node of the span set
+ */
+GeometryNode* BSPNode::GetSpanNode() {
+    Refine();
+    return sub;
+}
+
+/**
+ * Check if the node is a leaf without a divider.
+ *
+ * @return True if the node is a leaf
+ */
+bool BSPNode::IsLeaf() {
+    Refine();
+    return divider.get() == NULL;
+}
+
+/**
+ * Check if the node has been partitioned. Only lazily built nodes
+ * that have not been accessed yet are unrefined.
+ *
+ * @return False if the faces of the node are still unpartitioned.
+ */
+bool BSPNode::IsRefined() const {
+    return pending == NULL;
+}
+
+/**
+ * Get the frustum plane that culled the node last.
+ *
+ * @return Plane index.
+ * @see CullingPlanes
+ */
+unsigned int BSPNode::GetCullingHint() const {
+    return hint;
+}
+
+/**
+ * Set the frustum plane that culled the node last.
+ *
+ * @param hint Plane index.
+ * @see CullingPlanes
+ */
+void BSPNode::SetCullingHint(unsigned int hint) {
+    this->hint = hint;
+}
+
+/**
+ * Get the bounding box of all faces in the sub tree of this node.
+ * It does not refine lazy nodes, so it can be used for culling.
+ *
+ * @return Bounding box.
+ */
+Box BSPNode::GetBoundingBox() const {
+    return bb;
+}
+
+/**
+ * Get the number of faces in the sub tree of this node.
+ * The count is that of the face set the node was built from, kept up
+ * to date by BSPTransformer::Insert and BSPTransformer::Remove. It
+ * does not refine lazy nodes.
+ *
+ * @return Face count.
+ */
+unsigned int BSPNode::GetFaceCount() const {
+    return count;
+}
+
 /**
  * Compare the position of a point with the dividing plane of the BSP
  * node.
  *
  * @param point Point to find position of
- * @return relative position value
+ * @return relative position value, always 0 for leaves
  * @see Face::ComparePointPlane
  */
 int BSPNode::ComparePoint(Vector<3,float> point) {
+    if (IsLeaf()) return 0;
     return GetDivider()->ComparePointPlane(point);
 }
 
@@ -194,9 +330,10 @@ int BSPNode::ComparePoint(Vector<3,float> point) {
 /**
  * Get the dividing face of this node.
  *
- * @return Dividing face
+ * @return Dividing face, empty for leaves
  */
 FacePtr BSPNode::GetDivider() {
+    Refine();
     return divider;
 }
 
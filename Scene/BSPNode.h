@@ -12,6 +12,7 @@
 
 #include <Scene/ISceneNode.h>
 #include <Geometry/FaceSet.h>
+#include <Geometry/Box.h>
 
 namespace OpenEngine {
     namespace Resources {
@@ -32,6 +33,16 @@ static const float epsilon = 0.1f;
 /**
  * BSP tree node.
  *
+ * A node without a divider is a leaf. Its faces are not partitioned
+ * any further and are all kept in the span set. Leaves are created
+ * when the BSPTransformer stops construction early.
+ *
+ * A lazily built node holds its faces unpartitioned until it is
+ * first accessed. Any getter other than GetBoundingBox and
+ * GetFaceCount, visiting the sub nodes and serializing refine it one
+ * level with the transformer that built it, so culling by the bounds
+ * never refines invisible sub trees. Refinement is not thread safe.
+ *
  * @class BSPNode BSPNode.h SceneBSPTree/BSPNode.h
  */
 class BSPNode : public ISceneNode {
@@ -44,9 +55,19 @@ protected:
     BSPNode* back;              //!< link to back node
     FaceSet* span;    //!< faces in dividing plane
     GeometryNode* sub;          //!< sub node wrapping the divided faces
+    Box bb;                     //!< bounding box of the sub tree
+    bool pooled;                //!< node and children live in a NodeArena
+    unsigned int count;         //!< faces in the sub tree
+    float balance;              //!< front/back relation when built
+    FaceSet* pending;           //!< unpartitioned faces of a lazy node
+    BSPTransformer* builder;    //!< transformer refining a lazy node
+    unsigned int depth;         //!< depth of a lazy node
+    unsigned int hint;          //!< frustum plane that culled the node last
+
+    void Refine() { if (pending) Expand(); }
 
 public:
-    BSPNode() : front(NULL),back(NULL),span(NULL) {};
+    BSPNode() : front(NULL),back(NULL),span(NULL),sub(NULL),pooled(false),count(0),balance(0),pending(NULL),builder(NULL),depth(0),hint(0) {};
     BSPNode(const BSPNode& node);
     explicit BSPNode(BSPTransformer& trans, FaceSet* faces);
     virtual ~BSPNode();
@@ -57,15 +78,24 @@ public:
     BSPNode* GetFront();
     BSPNode* GetBack();
     FaceSet* GetSpan();
+    GeometryNode* GetSpanNode();
+    bool IsLeaf();
+    Box GetBoundingBox() const;
+    unsigned int GetFaceCount() const;
+    bool IsRefined() const;
+    unsigned int GetCullingHint() const;
+    void SetCullingHint(unsigned int hint);
 
     int ComparePoint(Vector<3,float> point);
 
     void Serialize(Resources::IArchiveWriter& w);
     void Deserialize(Resources::IArchiveReader& r);
 
-
 private:
+    friend class BSPTransformer;
 
+    void ComputeBoundingBox();
+    void Expand();
 };
 
 } // NS Scene
@@ -10,12 +10,18 @@
 #ifndef _BSP_PARTITION_STRATEGY_H_
 #define _BSP_PARTITION_STRATEGY_H_
 
+#include <Scene/BSPFaceSnapshot.h>
+#include <vector>
+
 namespace OpenEngine {
 namespace Scene {
 
 /**
  * Short description.
  *
+ * Strategies may be used by several build threads at once and must
+ * not keep state between calls.
+ *
  * @class BSPPartitionStrategy BSPPartitionStrategy.h Scene/BSPPartitionStrategy.h
  */
 class BSPPartitionStrategy {
@@ -35,19 +41,84 @@ public:
     virtual void Partition(FacePtr divider, FaceSet& faces,
                            FaceSet& front, FaceSet& span, FaceSet& back,
                            float epsilon = EPS) = 0;
+
+    /**
+     * Partition a vertex snapshot by one of its faces.
+     *
+     * The snapshot is the one the divider was selected from, so the
+     * divider plane and the face positions need not be computed
+     * again. The default implementation copies the snapshot to a face
+     * set and calls Partition.
+     *
+     * @pre faces is non-empty.
+     * @param[in] faces Snapshot to partition.
+     * @param[in] divider Index of the face to partition by.
+     * @param[out] front Front set after partitioning.
+     * @param[out] span  Spanning set after partitioning.
+     * @param[out] back  Back set after partitioning.
+     * @param epsilon Optional epsilon.
+     */
+    virtual void Partition(const BSPFaceSnapshot& faces, unsigned int divider,
+                           FaceSet& front, FaceSet& span, FaceSet& back,
+                           float epsilon = EPS) {
+        FaceSet set;
+        for (unsigned int i = 0; i < faces.Size(); i++)
+            set.Add(faces.GetFace(i));
+        Partition(faces.GetFace(divider), set, front, span, back, epsilon);
+    }
+
+protected:
+    /**
+     * Classify a snapshot against a plane in one vectorized pass.
+     * Faces in front, behind and in the plane are added to \a front,
+     * \a back and \a span. Faces straddling the plane are added to
+     * \a spanning for the strategy to handle.
+     *
+     * @see BSPFaceSnapshot::Classify
+     */
+    void Classify(const BSPFaceSnapshot& snapshot, const BSPPlane& plane,
+                  FaceSet& front, FaceSet& span, FaceSet& back,
+                  FaceSet& spanning, float epsilon) {
+        std::vector<unsigned char> sides(snapshot.Size());
+        if (sides.empty()) return;
+        snapshot.Classify(plane, epsilon, &sides[0]);
+        for (unsigned int i = 0; i < snapshot.Size(); i++) {
+            switch (sides[i]) {
+            case BSP_FRONT:    front.Add(snapshot.GetFace(i));    break;
+            case BSP_BACK:     back.Add(snapshot.GetFace(i));     break;
+            case BSP_SPANNING: spanning.Add(snapshot.GetFace(i)); break;
+            default:           span.Add(snapshot.GetFace(i));     break;
+            }
+        }
+    }
 };
 
 /**
  * Splitting partition strategy.
  * With this strategy the set of faces is destructively split, so that the
  * front, back and spanning set are truly disjoint.
+ * Only the faces straddling the divider are passed to FaceSet::Split.
  */
 class BSPSplitStrategy : public BSPPartitionStrategy {
 public:
     virtual void Partition(FacePtr divider, FaceSet& faces,
                            FaceSet& front, FaceSet& span, FaceSet& back,
                            float epsilon = EPS) {
-        faces.Split(divider, front, span, back, epsilon);
+        BSPFaceSnapshot snapshot(faces);
+        FaceSet split;
+        Classify(snapshot, BSPFaceSnapshot::MakePlane(*divider),
+                 front, span, back, split, epsilon);
+        if (split.Size() > 0)
+            split.Split(divider, front, span, back, epsilon);
+    }
+
+    virtual void Partition(const BSPFaceSnapshot& faces, unsigned int divider,
+                           FaceSet& front, FaceSet& span, FaceSet& back,
+                           float epsilon = EPS) {
+        FaceSet split;
+        Classify(faces, faces.GetPlane(divider), front, span, back, split, epsilon);
+        if (split.Size() > 0)
+            split.Split(faces.GetFace(divider), front, span, back, epsilon);
     }
 };
 
@@ -62,8 +133,19 @@ public:
     virtual void Partition(FacePtr divider, FaceSet& faces,
                            FaceSet& front, FaceSet& span, FaceSet& back,
                            float epsilon = EPS) {
+        BSPFaceSnapshot snapshot(faces);
+        FaceSet split;
+        Classify(snapshot, BSPFaceSnapshot::MakePlane(*divider),
+                 front, span, back, split, epsilon);
+        front.Add(&split);
+        back.Add(&split);
+    }
+
+    virtual void Partition(const BSPFaceSnapshot& faces, unsigned int divider,
+                           FaceSet& front, FaceSet& span, FaceSet& back,
+                           float epsilon = EPS) {
         FaceSet split;
-        faces.Divide(divider, front, span, back, split, epsilon);
+        Classify(faces, faces.GetPlane(divider), front, span, back, split, epsilon);
         front.Add(&split);
         back.Add(&split);
     }
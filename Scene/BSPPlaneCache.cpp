@@ -0,0 +1,127 @@
+// Plane cache for BSP construction.
+// -------------------------------------------------------------------
+// Copyright (C) 2007 OpenEngine.dk (See AUTHORS) 
+// 
+// This program is free software; It is covered by the GNU General 
+// Public License version 2 or any later version. 
+// See the GNU General Public License for more details (see LICENSE). 
+//--------------------------------------------------------------------
+
+#include <Scene/BSPPlaneCache.h>
+#include <algorithm>
+#include <cmath>
+#include <map>
+
+namespace OpenEngine {
+namespace Scene {
+
+// quantized plane used to group coplanar faces
+struct BSPPlaneKey {
+    long long k[4];
+    bool operator<(const BSPPlaneKey& o) const {
+        for (unsigned int i = 0; i < 4; i++)
+            if (k[i] != o.k[i]) return k[i] < o.k[i];
+        return false;
+    }
+};
+
+/**
+ * Create an empty plane cache.
+ *
+ * @param tolerance Quantization step for grouping coplanar faces.
+ */
+BSPPlaneCache::BSPPlaneCache(float tolerance)
+    : tolerance(tolerance) {
+
+}
+
+/**
+ * Add the planes of a face set to the cache.
+ * Faces already in the cache are added again, so a face set should
+ * only be added once.
+ *
+ * @param faces Faces to add.
+ */
+void BSPPlaneCache::Add(FaceSet& faces) {
+    // map the existing planes to their ids
+    std::map<BSPPlaneKey, unsigned int> ids;
+    for (unsigned int i = 0; i < planes.size(); i++) {
+        const BSPPlane& p = planes[i];
+        BSPPlaneKey key = { { (long long)std::floor(p.a / tolerance + 0.5f),
+                              (long long)std::floor(p.b / tolerance + 0.5f),
+                              (long long)std::floor(p.c / tolerance + 0.5f),
+                              (long long)std::floor(p.d / tolerance + 0.5f) } };
+        ids.insert(std::make_pair(key, i));
+    }
+    entries.reserve(entries.size() + faces.Size());
+    for (FaceList::iterator itr = faces.begin(); itr != faces.end(); itr++) {
+        BSPPlane p = BSPFaceSnapshot::MakePlane(**itr);
+        BSPPlaneKey key = { { (long long)std::floor(p.a / tolerance + 0.5f),
+                              (long long)std::floor(p.b / tolerance + 0.5f),
+                              (long long)std::floor(p.c / tolerance + 0.5f),
+                              (long long)std::floor(p.d / tolerance + 0.5f) } };
+        std::map<BSPPlaneKey, unsigned int>::iterator found = ids.find(key);
+        unsigned int id;
+        if (found == ids.end()) {
+            id = planes.size();
+            planes.push_back(p);
+            ids.insert(std::make_pair(key, id));
+        } else id = found->second;
+        entries.push_back(Entry(itr->get(), id));
+    }
+    std::sort(entries.begin(), entries.end());
+}
+
+/**
+ * Remove all faces and planes.
+ */
+void BSPPlaneCache::Clear() {
+    entries.clear();
+    planes.clear();
+}
+
+/**
+ * Look up the plane id of a face.
+ *
+ * @param face Face to look up.
+ * @param[out] id Plane id of the face.
+ * @return True if the face is in the cache.
+ */
+bool BSPPlaneCache::Lookup(const Face* face, unsigned int& id) const {
+    std::vector<Entry>::const_iterator itr =
+        std::lower_bound(entries.begin(), entries.end(), Entry(face, 0));
+    if (itr == entries.end() || itr->first != face) return false;
+    id = itr->second;
+    return true;
+}
+
+/**
+ * Get a cached plane.
+ *
+ * @param id Plane id.
+ * @return Plane of the first face added with the id.
+ */
+const BSPPlane& BSPPlaneCache::GetPlane(unsigned int id) const {
+    return planes[id];
+}
+
+/**
+ * Get the number of faces in the cache.
+ *
+ * @return Face count.
+ */
+unsigned int BSPPlaneCache::GetFaceCount() const {
+    return entries.size();
+}
+
+/**
+ * Get the number of distinct planes in the cache.
+ *
+ * @return Plane count.
+ */
+unsigned int BSPPlaneCache::GetPlaneCount() const {
+    return planes.size();
+}
+
+} // NS Scene
+} // NS OpenEngine
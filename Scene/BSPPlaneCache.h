@@ -0,0 +1,64 @@
+// Plane cache for BSP construction.
+// -------------------------------------------------------------------
+// Copyright (C) 2007 OpenEngine.dk (See AUTHORS) 
+// 
+// This program is free software; It is covered by the GNU General 
+// Public License version 2 or any later version. 
+// See the GNU General Public License for more details (see LICENSE). 
+//--------------------------------------------------------------------
+
+#ifndef _OE_BSP_PLANE_CACHE_H_
+#define _OE_BSP_PLANE_CACHE_H_
+
+#include <Scene/BSPFaceSnapshot.h>
+#include <vector>
+#include <utility>
+
+namespace OpenEngine {
+namespace Scene {
+
+/**
+ * Plane cache for BSP construction.
+ *
+ * Groups the coplanar faces of a build under a common plane id.
+ * Faces whose planes round to the same multiples of the tolerance in
+ * normal and offset share an id. Faces facing opposite ways are never
+ * grouped.
+ *
+ * Snapshots created with the cache take the ids from it, so divider
+ * strategies score each distinct plane only once. The ids are only
+ * used to skip candidates: partitions always classify by the exact
+ * plane of the chosen divider, as queries do. Near-identical planes
+ * on either side of a rounding boundary get different ids and are
+ * merely scored twice.
+ *
+ * The cache is filled before the build starts and is read-only
+ * afterwards, so it may be shared by all build threads. Faces created
+ * by splitting are not in the cache.
+ *
+ * @class BSPPlaneCache BSPPlaneCache.h Scene/BSPPlaneCache.h
+ */
+class BSPPlaneCache {
+private:
+    typedef std::pair<const Face*, unsigned int> Entry;
+
+    std::vector<Entry> entries;     //!< faces sorted by address
+    std::vector<BSPPlane> planes;   //!< distinct planes
+    float tolerance;
+
+public:
+    BSPPlaneCache(float tolerance = 0.001f);
+
+    void Add(FaceSet& faces);
+    void Clear();
+
+    bool Lookup(const Face* face, unsigned int& id) const;
+    const BSPPlane& GetPlane(unsigned int id) const;
+    unsigned int GetFaceCount() const;
+    unsigned int GetPlaneCount() const;
+};
+
+} // NS Scene
+} // NS OpenEngine
+
+#endif // _OE_BSP_PLANE_CACHE_H_
@@ -8,11 +8,131 @@
 //--------------------------------------------------------------------
 
 #include<Scene/BSPTransformer.h>
+#include<Core/WorkStealingPool.h>
+#include<Scene/BSPPlaneCache.h>
+#include<Utils/Timer.h>
+#include<Core/Mutex.h>
+#include<algorithm>
 
 namespace OpenEngine {
 namespace Scene {
 
-BSPTransformer::BSPTransformer() {
+// smallest sub tree checked for degradation on edits
+static const unsigned int min_rebuild_count = 8;
+
+// balance relation between two face counts
+static float Relation(unsigned int front, unsigned int back) {
+    if (front * back == 0) return 0;
+    return (front < back) ? (float)front / back : (float)back / front;
+}
+
+// grow a box to include a face
+static void Grow(Box& box, Face& face, bool empty) {
+    Vector<3,float> lo, hi;
+    if (!empty) {
+        lo = box.GetCenter() - box.GetCorner();
+        hi = box.GetCenter() + box.GetCorner();
+    }
+    for (unsigned int v = 0; v < 3; v++)
+        for (unsigned int j = 0; j < 3; j++) {
+            if ((empty && v == 0) || face.vert[v][j] < lo[j]) lo[j] = face.vert[v][j];
+            if ((empty && v == 0) || face.vert[v][j] > hi[j]) hi[j] = face.vert[v][j];
+        }
+    box = Box((lo + hi) * 0.5f, (hi - lo) * 0.5f);
+}
+
+/**
+ * Pending face set of a node under construction.
+ */
+struct BSPTransformer::BuildItem {
+    BSPNode* node;          //!< node to build
+    FaceSet* faces;         //!< faces of the node
+    unsigned int depth;     //!< depth of the node
+    bool owned;             //!< faces are owned by the build
+};
+
+/**
+ * State shared by all workers of a build.
+ */
+struct BSPTransformer::BuildState {
+    Utils::Timer timer;
+    Core::TaskGroup group;
+    BSPPlaneCache cache;
+    bool cached;
+    bool lazy;
+    BuildTimings timings;
+    Core::Mutex lock;
+    void Add(const BuildTimings& t) {
+        lock.Lock();
+        timings.Add(t);
+        lock.Unlock();
+    }
+};
+
+/**
+ * Task building a sub tree on a worker of the build pool.
+ */
+class BSPTransformer::BuildTask : public Core::ITask {
+private:
+    BSPTransformer& trans;
+    BuildItem item;
+    BuildState& state;
+public:
+    BuildTask(BSPTransformer& trans, BuildItem item, BuildState& state)
+        : trans(trans), item(item), state(state) {}
+    void Run(Core::WorkStealingPool& pool, unsigned int worker) {
+        std::vector<BuildItem> stack;
+        stack.push_back(item);
+        trans.BuildNodes(stack, state, worker);
+    }
+};
+
+/**
+ * Range of the index array pending construction in indexed mode.
+ */
+struct BSPTransformer::IndexedItem {
+    BSPNode* node;          //!< node to build
+    unsigned int begin;     //!< first index of the range
+    unsigned int end;       //!< end of the range
+    unsigned int depth;     //!< depth of the node
+};
+
+/**
+ * Face array and index array of an indexed build. Each build task
+ * has its own workspace.
+ */
+struct BSPTransformer::IndexedWorkspace {
+    std::vector<FacePtr> faces;
+    std::vector<unsigned int> index;
+};
+
+/**
+ * Task building a sub tree in indexed mode on a worker of the pool.
+ */
+class BSPTransformer::IndexedTask : public Core::ITask {
+private:
+    BSPTransformer& trans;
+    IndexedWorkspace* ws;
+    IndexedItem item;
+    BuildState& state;
+public:
+    IndexedTask(BSPTransformer& trans, IndexedWorkspace* ws,
+                IndexedItem item, BuildState& state)
+        : trans(trans), ws(ws), item(item), state(state) {}
+    ~IndexedTask() {
+        delete ws;
+    }
+    void Run(Core::WorkStealingPool& pool, unsigned int worker) {
+        std::vector<IndexedItem> stack;
+        stack.push_back(item);
+        trans.BuildIndexed(*ws, stack, state, worker);
+    }
+};
+
+BSPTransformer::BSPTransformer()
+    : pool(NULL), cutoff(0), maxDepth(0), leafCount(0), timeBudget(0)
+    , arena(NULL), planeCaching(true), rebuildThreshold(0.5)
+    , indexed(false), lazy(false) {
     findStrategy = new BSPDefaultFindDivider();
     partitionStrategy = new BSPSplitStrategy();
 }
@@ -20,6 +140,7 @@ BSPTransformer::BSPTransformer() {
 BSPTransformer::~BSPTransformer() {
     delete findStrategy;
     delete partitionStrategy;
+    delete pool;
 }
 
 /**
@@ -72,10 +193,699 @@ void BSPTransformer::SetPartitionStrategy(BSPPartitionStrategy* strategy) {
     partitionStrategy = strategy;
 }
 
+/**
+ * Enable or disable parallel construction.
+ * The front and back sub trees of a node are built concurrently when
+ * both hold at least \a cutoff faces. Smaller sub trees are built
+ * serially by the worker that reached them.
+ *
+ * @param threads Number of build threads, zero disables parallel
+ *                construction.
+ * @param cutoff Minimum face count of a sub tree built as a task.
+ */
+void BSPTransformer::SetParallelBuild(unsigned int threads, unsigned int cutoff) {
+    delete pool;
+    pool = (threads > 0) ? new Core::WorkStealingPool(threads) : NULL;
+    this->cutoff = cutoff;
+}
+
+/**
+ * Get the parallel build pool.
+ * @return Build pool, NULL if construction is serial.
+ */
+Core::WorkStealingPool* BSPTransformer::GetThreadPool() {
+    return pool;
+}
+
+/**
+ * Get the parallel cutoff.
+ * @return Minimum face count of a sub tree built as a task.
+ */
+unsigned int BSPTransformer::GetParallelCutoff() {
+    return cutoff;
+}
+
+/**
+ * Set the maximum depth of the tree.
+ * Nodes at this depth become leaves.
+ *
+ * @param depth Maximum depth, zero for no limit.
+ */
+void BSPTransformer::SetMaxDepth(unsigned int depth) {
+    maxDepth = depth;
+}
+
+/**
+ * Set the leaf face count.
+ * Face sets of at most this many faces are stored in leaves instead
+ * of being partitioned further.
+ *
+ * @param count Leaf face count, zero to partition all faces.
+ */
+void BSPTransformer::SetLeafFaceCount(unsigned int count) {
+    leafCount = count;
+}
+
+/**
+ * Set the time budget for building a tree.
+ * When the budget is spent all remaining face sets become leaves.
+ *
+ * @param milliseconds Time budget, zero for no limit.
+ */
+void BSPTransformer::SetTimeBudget(unsigned int milliseconds) {
+    timeBudget = milliseconds;
+}
+
+/**
+ * Enable or disable the plane cache.
+ * With the cache coplanar faces are grouped once per build, or per
+ * refined node of a lazy build, and only scored once as divider
+ * candidates. Partitions always use the exact plane of the chosen
+ * divider. It is enabled by default.
+ *
+ * @param enable True to use a plane cache.
+ * @see BSPPlaneCache
+ */
+void BSPTransformer::SetPlaneCaching(bool enable) {
+    planeCaching = enable;
+}
+
+/**
+ * Enable or disable indexed construction.
+ * In indexed mode the faces are partitioned as ranges of one index
+ * array instead of being copied to new face sets at every node.
+ * It is disabled by default.
+ *
+ * @param enable True to build in indexed mode.
+ */
+void BSPTransformer::SetIndexedBuild(bool enable) {
+    indexed = enable;
+}
+
+/**
+ * Enable or disable lazy construction.
+ * Lazily built nodes are partitioned when they are first accessed or
+ * by Refine. It is disabled by default.
+ *
+ * @param enable True to build lazily.
+ */
+void BSPTransformer::SetLazyBuild(bool enable) {
+    lazy = enable;
+}
+
+/**
+ * Set the arena to allocate tree nodes from.
+ * The arena is not owned by the transformer.
+ *
+ * @param arena Node arena, NULL to allocate nodes on the heap.
+ * @see NodeArena
+ */
+void BSPTransformer::SetNodeArena(NodeArena* arena) {
+    this->arena = arena;
+}
+
+/**
+ * Get the arena tree nodes are allocated from.
+ *
+ * @return Node arena, NULL if nodes are heap allocated.
+ */
+NodeArena* BSPTransformer::GetNodeArena() {
+    return arena;
+}
+
+BSPNode* BSPTransformer::NewNode() {
+    if (!arena) return new BSPNode();
+    BSPNode* node = arena->Adopt(new (*arena) BSPNode());
+    node->pooled = true;
+    return node;
+}
+
+/**
+ * Build a BSP tree into a node.
+ *
+ * The tree is constructed with an explicit stack of pending face
+ * sets. Each set is either turned into a leaf, if one of the build
+ * limits is reached, or partitioned by the divider found by the
+ * divider strategy. With a parallel build pool the back set is built
+ * as a separate task when both sets are above the parallel cutoff.
+ *
+ * No reference is kept to \a faces.
+ *
+ * @pre The face set supplied must be non-empty.
+ * @param root Empty node to build the tree into.
+ * @param faces Face set to build the tree from.
+ */
+void BSPTransformer::Build(BSPNode& root, FaceSet* faces) {
+    BuildTree(root, faces, timings);
+}
+
+/**
+ * Build a tree into a node, reporting the timings in \a out.
+ * Edits build through this, so the timings of the last full build
+ * are kept.
+ */
+void BSPTransformer::BuildTree(BSPNode& root, FaceSet* faces,
+                               BuildTimings& out) {
+    unsigned long long start = BuildTimings::Now();
+    if (lazy) {
+        out.Clear();
+        Defer(&root, new FaceSet(*faces), 0);
+        out.total = BuildTimings::Now() - start;
+        return;
+    }
+    BuildState state;
+    state.timer.Start();
+    state.lazy = false;
+    state.cached = planeCaching;
+    if (planeCaching) state.cache.Add(*faces);
+    unsigned int worker = (pool) ? pool->GetExternalWorker() : 0;
+    if (indexed) {
+        IndexedWorkspace ws;
+        ws.faces.reserve(faces->Size());
+        for (FaceList::iterator itr = faces->begin(); itr != faces->end(); itr++) {
+            ws.index.push_back(ws.faces.size());
+            ws.faces.push_back(*itr);
+        }
+        std::vector<IndexedItem> stack;
+        IndexedItem item = { &root, 0, (unsigned int)ws.index.size(), 0 };
+        stack.push_back(item);
+        BuildIndexed(ws, stack, state, worker);
+    } else {
+        std::vector<BuildItem> stack;
+        BuildItem item = { &root, faces, 0, false };
+        stack.push_back(item);
+        BuildNodes(stack, state, worker);
+    }
+    if (pool) pool->Wait(state.group, worker);
+    out = state.timings;
+    out.total = BuildTimings::Now() - start;
+}
+
+/**
+ * Get the timings of the last build.
+ * The divider, partition and allocation phases are summed over all
+ * build threads. Sub trees built by Insert and Rebuild are not
+ * included.
+ *
+ * @return Build timings.
+ */
+BuildTimings BSPTransformer::GetBuildTimings() const {
+    return timings;
+}
+
+void BSPTransformer::BuildIndexed(IndexedWorkspace& ws,
+                                  std::vector<IndexedItem>& stack,
+                                  BuildState& state, unsigned int worker) {
+    std::vector<unsigned char> sides;
+    BuildTimings t;
+    while (!stack.empty()) {
+        IndexedItem item = stack.back();
+        stack.pop_back();
+        BSPNode* node = item.node;
+        unsigned int size = item.end - item.begin;
+        unsigned int* index = &ws.index[item.begin];
+        node->count = size;
+        unsigned long long time = BuildTimings::Now();
+        node->span = new FaceSet();
+        node->sub = new GeometryNode(node->span);
+        unsigned long long now = BuildTimings::Now();
+        t.allocation += now - time;
+        time = now;
+
+        BSPFaceSnapshot snapshot(ws.faces, index, size,
+                                 (state.cached) ? &state.cache : NULL);
+        Vector<3,float> lo, hi;
+        snapshot.GetBounds(lo, hi);
+        node->bb = Box((lo + hi) * 0.5f, (hi - lo) * 0.5f);
+
+        // stop at a leaf if a build limit is reached
+        if ((maxDepth && item.depth >= maxDepth) ||
+            size <= leafCount ||
+            (timeBudget && state.timer.GetElapsedIntervals(1000) >= timeBudget)) {
+            for (unsigned int i = 0; i < size; i++)
+                node->span->Add(ws.faces[index[i]]);
+            t.allocation += BuildTimings::Now() - time;
+            continue;
+        }
+
+        // find divider and classify the range by it
+        unsigned int d = findStrategy->SelectDivider(snapshot, epsilon);
+        node->divider = snapshot.GetFace(d);
+        now = BuildTimings::Now();
+        t.divider += now - time;
+        time = now;
+        sides.resize(size);
+        snapshot.Classify(snapshot.GetPlane(d), epsilon, &sides[0]);
+
+        // partition in place to [front | spanning | coplanar | back]
+        unsigned int lo_i = 0, mid = 0, hi_i = size;
+        while (mid < hi_i) {
+            if (sides[mid] == BSP_FRONT) {
+                std::swap(index[lo_i], index[mid]);
+                std::swap(sides[lo_i++], sides[mid++]);
+            } else if (sides[mid] == BSP_BACK) {
+                --hi_i;
+                std::swap(index[mid], index[hi_i]);
+                std::swap(sides[mid], sides[hi_i]);
+            } else mid++;
+        }
+        unsigned int nfront = lo_i, nback = size - hi_i;
+        unsigned int split = lo_i;
+        for (unsigned int i = lo_i; i < hi_i; i++)
+            if (sides[i] == BSP_SPANNING) {
+                std::swap(index[split], index[i]);
+                std::swap(sides[split++], sides[i]);
+            }
+
+        // coplanar faces are the payload of the node
+        for (unsigned int i = split; i < hi_i; i++)
+            node->span->Add(ws.faces[index[i]]);
+
+        // partition the straddling faces with the partition strategy
+        FaceSet straddle, fpieces, bpieces;
+        for (unsigned int i = lo_i; i < split; i++)
+            straddle.Add(ws.faces[index[i]]);
+        if (straddle.Size() > 0)
+            partitionStrategy->Partition(node->divider, straddle,
+                                         fpieces, *node->span, bpieces, epsilon);
+
+        // place the pieces between the front and back ranges if they
+        // fit, otherwise move the ranges to the end of the index array
+        unsigned int gap = hi_i - lo_i;
+        unsigned int pf = fpieces.Size(), pb = bpieces.Size();
+        IndexedItem fitem = { NULL, item.begin, item.begin + nfront + pf, item.depth + 1 };
+        IndexedItem bitem = { NULL, item.begin + hi_i - pb, item.end, item.depth + 1 };
+        if (pf + pb > gap) {
+            unsigned int base = ws.index.size();
+            unsigned int moved = (pf > gap) ? nfront + pf : 0;
+            ws.index.resize(base + moved + pb + nback);
+            index = &ws.index[item.begin];
+            if (pf > gap) {
+                std::copy(index, index + nfront, ws.index.begin() + base);
+                fitem.begin = base;
+                fitem.end = base + moved;
+            }
+            bitem.begin = base + moved;
+            bitem.end = bitem.begin + pb + nback;
+            std::copy(index + hi_i, index + size, ws.index.begin() + bitem.begin + pb);
+        }
+        unsigned int at = fitem.end - pf;
+        for (FaceList::iterator itr = fpieces.begin(); itr != fpieces.end(); itr++) {
+            ws.index[at++] = ws.faces.size();
+            ws.faces.push_back(*itr);
+        }
+        at = bitem.begin;
+        for (FaceList::iterator itr = bpieces.begin(); itr != bpieces.end(); itr++) {
+            ws.index[at++] = ws.faces.size();
+            ws.faces.push_back(*itr);
+        }
+        unsigned int fcount = fitem.end - fitem.begin;
+        unsigned int bcount = bitem.end - bitem.begin;
+        node->balance = Relation(fcount, bcount);
+        now = BuildTimings::Now();
+        t.partition += now - time;
+        time = now;
+
+        // queue the sub nodes, large back ranges get their own workspace
+        if (bcount > 0) {
+            bitem.node = node->back = NewNode();
+            // never hand an empty set to a task, also with a zero cutoff
+            if (pool && fcount > 0 && fcount >= cutoff && bcount >= cutoff) {
+                IndexedWorkspace* sub = new IndexedWorkspace();
+                sub->faces.reserve(bcount);
+                for (unsigned int i = bitem.begin; i < bitem.end; i++) {
+                    sub->index.push_back(sub->faces.size());
+                    sub->faces.push_back(ws.faces[ws.index[i]]);
+                }
+                IndexedItem sitem = { bitem.node, 0, bcount, bitem.depth };
+                pool->Submit(new IndexedTask(*this, sub, sitem, state),
+                             state.group, worker);
+            } else
+                stack.push_back(bitem);
+        }
+        if (fcount > 0) {
+            fitem.node = node->front = NewNode();
+            stack.push_back(fitem);
+        }
+        t.allocation += BuildTimings::Now() - time;
+    }
+    state.Add(t);
+}
+
+void BSPTransformer::BuildNodes(std::vector<BuildItem>& stack,
+                                BuildState& state, unsigned int worker) {
+    BuildTimings t;
+    while (!stack.empty()) {
+        BuildItem item = stack.back();
+        stack.pop_back();
+        BSPNode* node = item.node;
+        unsigned int size = item.faces->Size();
+
+        // the sub tree holds the faces of the set or pieces of them
+        node->bb = Box(*item.faces);
+        node->count = size;
+        unsigned long long time = BuildTimings::Now(), now;
+
+        // stop at a leaf if a build limit is reached
+        if ((maxDepth && item.depth >= maxDepth) ||
+            size <= leafCount ||
+            (timeBudget && state.timer.GetElapsedIntervals(1000) >= timeBudget)) {
+            node->span = (item.owned) ? item.faces : new FaceSet(*item.faces);
+            node->sub = new GeometryNode(node->span);
+            t.allocation += BuildTimings::Now() - time;
+            continue;
+        }
+
+        // create face sets
+        node->span = new FaceSet();
+        FaceSet* fset = new FaceSet();
+        FaceSet* bset = new FaceSet();
+
+        // wrap the spanning set with a geometry node (for traversal)
+        node->sub = new GeometryNode(node->span);
+        now = BuildTimings::Now();
+        t.allocation += now - time;
+        time = now;
+
+        {
+            // the divider and the partition share the snapshot
+            BSPFaceSnapshot snapshot(*item.faces, (state.cached) ? &state.cache : NULL);
+
+            // find divider
+            unsigned int index = findStrategy->SelectDivider(snapshot, epsilon);
+            node->divider = snapshot.GetFace(index);
+            now = BuildTimings::Now();
+            t.divider += now - time;
+            time = now;
+
+            // partition to the sets
+            partitionStrategy->Partition(snapshot, index,
+                                         *fset, *node->span, *bset, epsilon);
+        }
+        if (item.owned) delete item.faces;
+        node->balance = Relation(fset->Size(), bset->Size());
+        now = BuildTimings::Now();
+        t.partition += now - time;
+        time = now;
+
+        // queue the sub nodes
+        BuildItem fitem = { NULL, fset, item.depth + 1, true };
+        BuildItem bitem = { NULL, bset, item.depth + 1, true };
+        if (bset->Size() > 0) {
+            bitem.node = node->back = NewNode();
+            if (state.lazy)
+                Defer(bitem.node, bset, bitem.depth);
+            else if (pool && fset->Size() > 0
+                && (unsigned int)fset->Size() >= cutoff
+                && (unsigned int)bset->Size() >= cutoff)
+                pool->Submit(new BuildTask(*this, bitem, state), state.group, worker);
+            else
+                stack.push_back(bitem);
+        } else delete bset;
+        if (fset->Size() > 0) {
+            fitem.node = node->front = NewNode();
+            if (state.lazy)
+                Defer(fitem.node, fset, fitem.depth);
+            else
+                stack.push_back(fitem);
+        } else delete fset;
+        t.allocation += BuildTimings::Now() - time;
+    }
+    state.Add(t);
+}
+
+/**
+ * Set the degradation threshold for rebuilding sub trees on edits.
+ *
+ * A node on the path of an insertion or removal is rebuilt when its
+ * front/back relation has dropped below (1 - threshold) times the
+ * relation it was built with. A leaf is rebuilt when it holds more
+ * than (1 + threshold) times the leaf face count. Sub trees of fewer
+ * than eight faces are never rebuilt.
+ *
+ * @param threshold Tolerated relative loss of balance, zero disables
+ *                  rebuilding. The default is 0.5.
+ */
+void BSPTransformer::SetRebuildThreshold(float threshold) {
+    rebuildThreshold = threshold;
+}
+
+bool BSPTransformer::IsDegraded(BSPNode* node) {
+    if (rebuildThreshold <= 0 || node->count < min_rebuild_count ||
+        node->pending)
+        return false;
+    if (node->IsLeaf())
+        return leafCount > 0 &&
+            node->span->Size() > leafCount * (1 + rebuildThreshold);
+    unsigned int fcount = (node->front) ? node->front->count : 0;
+    unsigned int bcount = (node->back)  ? node->back->count  : 0;
+    return Relation(fcount, bcount) < node->balance * (1 - rebuildThreshold);
+}
+
+/**
+ * Add faces to a child of a node being inserted into.
+ * Existing children receive the faces through the insertion stack,
+ * missing children are built from them.
+ */
+void BSPTransformer::Attach(BSPNode*& child, FaceSet& faces,
+                            std::vector<std::pair<BSPNode*, FacePtr> >& stack) {
+    if (faces.Size() == 0) return;
+    if (child == NULL) {
+        child = NewNode();
+        BuildTimings edit;
+        BuildTree(*child, &faces, edit);
+        return;
+    }
+    for (FaceList::iterator itr = faces.begin(); itr != faces.end(); itr++)
+        stack.push_back(std::make_pair(child, *itr));
+}
+
+/**
+ * Insert a face into a built tree.
+ *
+ * The face is pushed down from the root. Where it lies in a dividing
+ * plane it is added to the span of the node, and where it straddles
+ * a divider it is partitioned with the partition strategy and the
+ * pieces continue on each side. Faces reaching a missing child
+ * become a new sub tree, faces reaching a leaf are added to it.
+ *
+ * Afterwards the topmost degraded node on the path is rebuilt.
+ *
+ * @param root Root of the tree.
+ * @param face Face to insert.
+ * @see SetRebuildThreshold
+ */
+void BSPTransformer::Insert(BSPNode& root, FacePtr face) {
+    std::vector<BSPNode*> path;
+    std::vector<std::pair<BSPNode*, FacePtr> > stack;
+    stack.push_back(std::make_pair(&root, face));
+    while (!stack.empty()) {
+        BSPNode* node = stack.back().first;
+        FacePtr f = stack.back().second;
+        stack.pop_back();
+        path.push_back(node);
+        Grow(node->bb, *f, node->count == 0);
+        node->count++;
+        if (node->pending) {
+            node->pending->Add(f);
+            continue;
+        }
+        if (node->IsLeaf()) {
+            node->span->Add(f);
+            continue;
+        }
+        FaceSet one, fset, bset;
+        one.Add(f);
+        partitionStrategy->Partition(node->divider, one, fset, *node->span, bset, epsilon);
+        Attach(node->front, fset, stack);
+        Attach(node->back, bset, stack);
+    }
+    // the path is in top down order
+    for (unsigned int i = 0; i < path.size(); i++)
+        if (IsDegraded(path[i])) {
+            Rebuild(*path[i]);
+            break;
+        }
+}
+
+/**
+ * Remove a face from a built tree.
+ *
+ * The face is searched for by identity along the path it would be
+ * inserted by, on both sides of dividers it straddles. Only the face
+ * itself is removed; pieces it was split into during construction
+ * are different faces and stay in the tree. The divider planes are
+ * kept even if their face is removed.
+ *
+ * Afterwards the topmost degraded node on the path is rebuilt.
+ *
+ * @param root Root of the tree.
+ * @param face Face to remove.
+ * @return True if the face was found.
+ */
+bool BSPTransformer::Remove(BSPNode& root, FacePtr face) {
+    // visited nodes with the index of their parent
+    std::vector<std::pair<BSPNode*, int> > path;
+    path.push_back(std::make_pair(&root, -1));
+    // path indices of the nodes the face was removed from
+    std::vector<unsigned int> found;
+    BSPPlane plane;
+    for (unsigned int i = 0; i < path.size(); i++) {
+        BSPNode* node = path[i].first;
+        FaceSet* faces = (node->pending) ? node->pending : node->span;
+        for (FaceList::iterator itr = faces->begin(); itr != faces->end(); itr++)
+            if (*itr == face) {
+                faces->Remove(face);
+                found.push_back(i);
+                break;
+            }
+        if (node->pending || node->IsLeaf()) continue;
+        plane = BSPFaceSnapshot::MakePlane(*node->divider);
+        bool infront = false, behind = false;
+        for (unsigned int v = 0; v < 3; v++) {
+            float d = plane.a * face->vert[v][0] + plane.b * face->vert[v][1]
+                + plane.c * face->vert[v][2] - plane.d;
+            if (d >  epsilon) infront = true;
+            if (d < -epsilon) behind = true;
+        }
+        if (infront && node->front) path.push_back(std::make_pair(node->front, (int)i));
+        if (behind  && node->back)  path.push_back(std::make_pair(node->back,  (int)i));
+    }
+    // a face stored on both sides of a divider is still one face to
+    // the ancestors they share, so each node is decremented once
+    std::vector<bool> counted(path.size(), false);
+    for (unsigned int i = 0; i < found.size(); i++)
+        for (int p = found[i]; p >= 0 && !counted[p]; p = path[p].second) {
+            counted[p] = true;
+            path[p].first->count--;
+        }
+    bool removed = !found.empty();
+    if (removed)
+        for (unsigned int i = 0; i < path.size(); i++)
+            if (IsDegraded(path[i].first)) {
+                Rebuild(*path[i].first);
+                break;
+            }
+    return removed;
+}
+
+/**
+ * Rebuild the sub tree of a node from the faces it holds.
+ * The node object itself is kept, so links to it stay valid. The
+ * build timings of the transformer are not changed.
+ *
+ * @param node Root of the sub tree to rebuild.
+ */
+void BSPTransformer::Rebuild(BSPNode& node) {
+    // collect the faces of the sub tree
+    FaceSet faces;
+    std::vector<BSPNode*> stack;
+    stack.push_back(&node);
+    while (!stack.empty()) {
+        BSPNode* n = stack.back();
+        stack.pop_back();
+        faces.Add((n->pending) ? n->pending : n->span);
+        if (n->front) stack.push_back(n->front);
+        if (n->back)  stack.push_back(n->back);
+    }
+
+    bool heap = (arena == NULL);
+    BSPNode* fresh = NewNode();
+    BuildTimings edit;
+    if (faces.Size() > 0)
+        BuildTree(*fresh, &faces, edit);
+    else {
+        fresh->span = new FaceSet();
+        fresh->sub = new GeometryNode(fresh->span);
+        fresh->bb = node.bb;
+    }
+
+    // swap the contents so the old sub tree goes with the fresh node
+    std::swap(node.divider, fresh->divider);
+    std::swap(node.front,   fresh->front);
+    std::swap(node.back,    fresh->back);
+    std::swap(node.span,    fresh->span);
+    std::swap(node.sub,     fresh->sub);
+    std::swap(node.bb,      fresh->bb);
+    std::swap(node.pooled,  fresh->pooled);
+    std::swap(node.count,   fresh->count);
+    std::swap(node.balance, fresh->balance);
+    std::swap(node.pending, fresh->pending);
+    std::swap(node.builder, fresh->builder);
+    std::swap(node.depth,   fresh->depth);
+    // arena nodes are destroyed when the arena is cleared
+    if (heap) delete fresh;
+}
+
+/**
+ * Make a node lazy, holding its faces until it is refined.
+ * The node takes ownership of \a faces.
+ */
+void BSPTransformer::Defer(BSPNode* node, FaceSet* faces, unsigned int depth) {
+    node->pending = faces;
+    node->builder = this;
+    node->depth = depth;
+    node->bb = Box(*faces);
+    node->count = faces->Size();
+}
+
+/**
+ * Partition a lazy node one level.
+ * Its children are created as lazy nodes. Nodes that are already
+ * refined are left as they are. With plane caching the pending faces
+ * are cached before they are partitioned.
+ *
+ * @param node Node to refine.
+ */
+void BSPTransformer::Refine(BSPNode& node) {
+    if (!node.pending) return;
+    BuildItem item = { &node, node.pending, node.depth, true };
+    node.pending = NULL;
+    node.builder = NULL;
+    BuildState state;
+    state.timer.Start();
+    state.cached = planeCaching;
+    if (planeCaching) state.cache.Add(*item.faces);
+    state.lazy = true;
+    std::vector<BuildItem> stack;
+    stack.push_back(item);
+    BuildNodes(stack, state, 0);
+}
+
+/**
+ * Refine the lazy nodes of a tree breadth first until a time budget
+ * is spent. The refined part of the tree is walked on every call.
+ *
+ * @param root Root of the tree.
+ * @param milliseconds Time budget, at least one node is refined.
+ * @return True if no lazy nodes are left.
+ */
+bool BSPTransformer::Refine(BSPNode& root, unsigned int milliseconds) {
+    Utils::Timer timer;
+    timer.Start();
+    std::vector<BSPNode*> queue;
+    queue.push_back(&root);
+    bool refined = false;
+    for (unsigned int i = 0; i < queue.size(); i++) {
+        BSPNode* node = queue[i];
+        if (node->pending) {
+            if (refined && timer.GetElapsedIntervals(1000) >= milliseconds)
+                return false;
+            Refine(*node);
+            refined = true;
+        }
+        if (node->front) queue.push_back(node->front);
+        if (node->back)  queue.push_back(node->back);
+    }
+    return true;
+}
+
 void BSPTransformer::VisitGeometryNode(GeometryNode* node) {
-    if (node->GetFaceSet()->Size() != 0)
-        node->GetParent()->ReplaceNode(node, new BSPNode(*this, node->GetFaceSet()));
-    else
+    if (node->GetFaceSet()->Size() != 0) {
+        BSPNode* root = NewNode();
+        Build(*root, node->GetFaceSet());
+        node->GetParent()->ReplaceNode(node, root);
+    } else
         node->GetParent()->RemoveNode(node);
 }
 
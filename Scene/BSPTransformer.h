@@ -11,12 +11,19 @@
 #define _OE_BSP_TRANSFORMER_H_
 
 #include <Scene/BSPNode.h>
+#include <Scene/NodeArena.h>
 #include <Scene/BSPFindDividerStrategy.h>
 #include <Scene/BSPPartitionStrategy.h>
+#include <Scene/TreeStatistics.h>
 #include <Scene/GeometryNode.h>
 #include <Scene/ISceneNodeVisitor.h>
+#include <vector>
+#include <utility>
 
 namespace OpenEngine {
+    namespace Core {
+        class WorkStealingPool;
+    }
 namespace Scene {
 
 /**
@@ -34,6 +41,74 @@ namespace Scene {
  * bspt.Transform(*scene);
  * @endcode
  *
+ * Construction may run in parallel on a work stealing pool. The front
+ * and back sub trees of a node are then built concurrently as long as
+ * both hold at least the parallel cutoff number of faces.
+ * The strategy objects are shared by all build threads and must
+ * therefore be reentrant.
+ *
+ * @code
+ * // build on four threads, serially below 2000 faces
+ * bspt.SetParallelBuild(4, 2000);
+ * @endcode
+ *
+ * The tree is built with an explicit stack, so deep trees do not
+ * overflow the call stack. Construction can be cut short by a maximum
+ * depth, a leaf face count or a time budget. Face sets reaching one
+ * of the limits are not partitioned further but stored whole in leaf
+ * nodes, trading tree quality for build time and node count.
+ *
+ * @code
+ * // leafy tree of at most 20 levels built within 200 milliseconds
+ * bspt.SetMaxDepth(20);
+ * bspt.SetLeafFaceCount(32);
+ * bspt.SetTimeBudget(200);
+ * @endcode
+ *
+ * Built trees can be edited in place. Insert pushes a face down the
+ * tree, splitting it with the partition strategy where it straddles
+ * a divider, and Remove takes a face out by identity. Both cost
+ * O(depth) per face piece. Once a sub tree on the edited path has
+ * lost too much of its balance it is rebuilt on its own.
+ *
+ * @code
+ * bspt.SetRebuildThreshold(0.5);
+ * bspt.Insert(*root, face);
+ * bspt.Remove(*root, other);
+ * @endcode
+ *
+ * In indexed mode the faces are kept in one array and each node
+ * partitions its range of an index array in place, quicksort style.
+ * New faces are only created for the pieces of split faces, and face
+ * sets only for the faces stored in the nodes.
+ *
+ * In lazy mode a build only records the faces and bounds of the root.
+ * Each node is partitioned one level the first time it is accessed,
+ * see BSPNode, so level loading does not pay for sub trees that are
+ * never reached. Refine with a time budget partitions pending nodes
+ * breadth first, for instance in idle frames. The transformer must
+ * outlive the lazy nodes it built. Lazy builds ignore the indexed
+ * mode, the parallel build and the time budget.
+ *
+ * @code
+ * bspt.SetLazyBuild(true);
+ * bspt.Transform(*level);
+ * // ... in idle frames
+ * bspt.Refine(*root, 2);
+ * @endcode
+ *
+ * Each build keeps a BSPPlaneCache of the input faces, which the
+ * divider and partition strategies share through the snapshots they
+ * are given. Coplanar faces are then scored as one candidate. Lazy
+ * builds cache the pending faces of each node as it is refined, so
+ * pieces of faces split further up are grouped too, while an eager
+ * build scores each piece on its own. A lazy tree can therefore pick
+ * a different divider among near-coplanar candidates than the eager
+ * tree.
+ *
+ * With a NodeArena all nodes of the trees are allocated from the
+ * arena and the trees are freed together by clearing it.
+ *
  * @see GeometryNode
  *
  * @class BSPTransformer BSPTransformer.h Scene/BSPTransformer.h
@@ -42,6 +117,35 @@ class BSPTransformer : public ISceneNodeVisitor {
 private:
     BSPFindDividerStrategy* findStrategy;
     BSPPartitionStrategy* partitionStrategy;
+    Core::WorkStealingPool* pool;
+    unsigned int cutoff;
+    unsigned int maxDepth;
+    unsigned int leafCount;
+    unsigned int timeBudget;
+    NodeArena* arena;
+    bool planeCaching;
+    float rebuildThreshold;
+    bool indexed;
+    bool lazy;
+    BuildTimings timings;
+
+    struct BuildItem;
+    struct BuildState;
+    class BuildTask;
+    struct IndexedItem;
+    struct IndexedWorkspace;
+    class IndexedTask;
+
+    void BuildNodes(std::vector<BuildItem>& stack, BuildState& state,
+                    unsigned int worker);
+    void BuildIndexed(IndexedWorkspace& ws, std::vector<IndexedItem>& stack,
+                      BuildState& state, unsigned int worker);
+    void BuildTree(BSPNode& root, FaceSet* faces, BuildTimings& out);
+    BSPNode* NewNode();
+    void Defer(BSPNode* node, FaceSet* faces, unsigned int depth);
+    void Attach(BSPNode*& child, FaceSet& faces,
+                std::vector<std::pair<BSPNode*, FacePtr> >& stack);
+    bool IsDegraded(BSPNode* node);
 
 public:
     BSPTransformer();
@@ -55,6 +159,32 @@ public:
     virtual BSPPartitionStrategy* GetPartitionStrategy();
     virtual void SetPartitionStrategy(BSPPartitionStrategy* strategy);
 
+    virtual void SetParallelBuild(unsigned int threads, unsigned int cutoff = 2000);
+    virtual Core::WorkStealingPool* GetThreadPool();
+    virtual unsigned int GetParallelCutoff();
+
+    virtual void SetMaxDepth(unsigned int depth);
+    virtual void SetLeafFaceCount(unsigned int count);
+    virtual void SetTimeBudget(unsigned int milliseconds);
+
+    virtual void SetPlaneCaching(bool enable);
+    virtual void SetIndexedBuild(bool enable);
+    virtual void SetLazyBuild(bool enable);
+
+    virtual void SetNodeArena(NodeArena* arena);
+    virtual NodeArena* GetNodeArena();
+
+    virtual void Build(BSPNode& root, FaceSet* faces);
+    virtual BuildTimings GetBuildTimings() const;
+
+    virtual void SetRebuildThreshold(float threshold);
+    virtual void Insert(BSPNode& root, FacePtr face);
+    virtual bool Remove(BSPNode& root, FacePtr face);
+    virtual void Rebuild(BSPNode& node);
+
+    virtual void Refine(BSPNode& node);
+    virtual bool Refine(BSPNode& root, unsigned int milliseconds);
+
     virtual void VisitGeometryNode(GeometryNode* node);
 };
 
@@ -0,0 +1,496 @@
+// Flattened BSP tree.
+// -------------------------------------------------------------------
+// Copyright (C) 2007 OpenEngine.dk (See AUTHORS) 
+// 
+// This program is free software; It is covered by the GNU General 
+// Public License version 2 or any later version. 
+// See the GNU General Public License for more details (see LICENSE). 
+//--------------------------------------------------------------------
+
+#include <Scene/CompiledBSP.h>
+#include <Scene/BSPNode.h>
+#include <Scene/BSPFaceSnapshot.h>
+#include <Scene/TreeFile.h>
+
+namespace OpenEngine {
+namespace Scene {
+
+// range of points pending location in a node
+struct BSPPointRange {
+    int node;
+    unsigned int begin, end;
+};
+
+// segment of a ray pending in a node
+struct BSPRaySegment {
+    unsigned int ray;
+    float tmin, tmax;
+};
+
+// range of ray segments pending in a node
+struct BSPRayRange {
+    int node;
+    unsigned int begin, end;
+};
+
+// pending node of the compilation with the index of its parent
+struct BSPCompileItem {
+    BSPNode* node;
+    int parent;
+    bool front;
+};
+
+/**
+ * Create an empty compiled tree.
+ */
+CompiledBSP::CompiledBSP()
+    : nodes(NULL), nodeCount(0) {
+
+}
+
+/**
+ * Compile a BSP tree.
+ *
+ * @param root Root of the tree to compile.
+ */
+CompiledBSP::CompiledBSP(BSPNode* root)
+    : nodes(NULL), nodeCount(0) {
+    Compile(root);
+}
+
+/**
+ * Destructor.
+ */
+CompiledBSP::~CompiledBSP() {
+
+}
+
+/**
+ * Compile a BSP tree, replacing the current contents.
+ *
+ * The nodes are written in depth first order with the front child
+ * directly after its parent. The faces are shared with the source
+ * tree, which may be deleted afterwards. Equal vertices share an
+ * entry in the vertex block.
+ *
+ * @param root Root of the tree to compile, may be NULL.
+ */
+void CompiledBSP::Compile(BSPNode* root) {
+    Clear();
+    if (root == NULL) return;
+
+    unsigned int packed = 0;
+    std::vector<BSPCompileItem> stack;
+    BSPCompileItem p = { root, -1, false };
+    stack.push_back(p);
+    while (!stack.empty()) {
+        p = stack.back();
+        stack.pop_back();
+        BSPNode* bsp = p.node;
+        int index = nodeStore.size();
+        if (p.parent >= 0) {
+            if (p.front) nodeStore[p.parent].front = index;
+            else         nodeStore[p.parent].back  = index;
+        }
+
+        Node n;
+        if (bsp->IsLeaf()) {
+            n.plane[0] = n.plane[1] = n.plane[2] = n.plane[3] = 0;
+        } else {
+            BSPPlane plane = BSPFaceSnapshot::MakePlane(*bsp->GetDivider());
+            n.plane[0] = plane.a;
+            n.plane[1] = plane.b;
+            n.plane[2] = plane.c;
+            n.plane[3] = plane.d;
+        }
+        n.front = n.back = -1;
+        n.first = packed;
+        FaceSet* span = bsp->GetSpan();
+        if (span)
+            for (FaceList::iterator itr = span->begin(); itr != span->end(); itr++) {
+                AddFace(*itr);
+                packed++;
+            }
+        n.count = packed - n.first;
+        nodeStore.push_back(n);
+
+        // push back first so the front child is compiled next
+        if (bsp->GetBack()) {
+            BSPCompileItem b = { bsp->GetBack(), index, false };
+            stack.push_back(b);
+        }
+        if (bsp->GetFront()) {
+            BSPCompileItem f = { bsp->GetFront(), index, true };
+            stack.push_back(f);
+        }
+    }
+    Pack();
+
+    nodes = &nodeStore[0];
+    nodeCount = nodeStore.size();
+}
+
+/**
+ * Remove all nodes, faces and materials, and release a loaded file.
+ */
+void CompiledBSP::Clear() {
+    ClearGeometry();
+    nodeStore.clear();
+    nodes = NULL;
+    nodeCount = 0;
+}
+
+/**
+ * Save the tree to a file.
+ * The materials are saved as indices into the material table, see
+ * GetMaterials().
+ *
+ * @param filename File to write.
+ * @throws ResourceException if the file cannot be written.
+ * @see TreeFile
+ */
+void CompiledBSP::Save(const std::string& filename) const {
+    SaveFile(filename, TreeFile::BSP_TREE, sizeof(Node), nodes, nodeCount);
+}
+
+/**
+ * Load a tree from a file, replacing the current contents.
+ * The file is used in place until the tree is cleared or deleted.
+ * The loaded tree has no materials until they are set with
+ * SetMaterials().
+ *
+ * @param filename File to read.
+ * @param verify Check the checksum of the file.
+ * @throws ResourceException if the file does not hold a BSP tree.
+ * @see TreeFile
+ */
+void CompiledBSP::Load(const std::string& filename, bool verify) {
+    Clear();
+    nodes = (const Node*)LoadFile(filename, TreeFile::BSP_TREE, sizeof(Node),
+                                  verify, nodeCount);
+}
+
+/**
+ * Get the number of nodes.
+ * The root is node 0 if the tree is non-empty.
+ *
+ * @return Node count.
+ */
+unsigned int CompiledBSP::GetNodeCount() const {
+    return nodeCount;
+}
+
+/**
+ * Get a node.
+ *
+ * @param index Node index.
+ * @return Compiled node.
+ */
+const CompiledBSP::Node& CompiledBSP::GetNode(unsigned int index) const {
+    return nodes[index];
+}
+
+/**
+ * Check if a node is a leaf without a dividing plane.
+ *
+ * @param index Node index.
+ * @return True if the node is a leaf.
+ */
+bool CompiledBSP::IsLeaf(unsigned int index) const {
+    const float* p = nodes[index].plane;
+    return p[0] == 0 && p[1] == 0 && p[2] == 0;
+}
+
+/**
+ * Compare the position of a point with the dividing plane of a node.
+ *
+ * @param index Node index.
+ * @param point Point to find position of.
+ * @param epsilon Distance within which the point is in the plane.
+ * @return 1 in front, -1 behind and 0 in the plane, always 0 for leaves
+ * @see BSPNode::ComparePoint
+ */
+int CompiledBSP::ComparePoint(unsigned int index, const Vector<3,float>& point,
+                              float epsilon) const {
+    const float* p = nodes[index].plane;
+    float dist = p[0]*point[0] + p[1]*point[1] + p[2]*point[2] - p[3];
+    if (dist >  epsilon) return 1;
+    if (dist < -epsilon) return -1;
+    return 0;
+}
+
+/**
+ * Order the nodes for rendering as seen from a viewpoint.
+ *
+ * For back to front order the sub tree on the far side of each
+ * dividing plane is emitted before the node itself and the near sub
+ * tree after it, front to back order is the reverse. The face range
+ * of each emitted node can then be drawn in sequence.
+ *
+ * @param viewpoint Position of the viewer.
+ * @param order Traversal order.
+ * @param[out] result Node indices in traversal order. The vector is
+ *                    cleared first, its storage is reused.
+ */
+void CompiledBSP::Traverse(const Vector<3,float>& viewpoint, Order order,
+                           std::vector<unsigned int>& result) const {
+    result.clear();
+    if (nodeCount == 0) return;
+    result.reserve(nodeCount);
+    // entries are node indices, negative entries emit node -(i+1)
+    std::vector<int> stack;
+    stack.push_back(0);
+    while (!stack.empty()) {
+        int i = stack.back();
+        stack.pop_back();
+        if (i < 0) {
+            result.push_back(-(i+1));
+            continue;
+        }
+        const Node& n = nodes[i];
+        bool infront = ComparePoint(i, viewpoint) >= 0;
+        // the near side is the one containing the viewpoint
+        int nearer = (infront) ? n.front : n.back;
+        int farther = (infront) ? n.back : n.front;
+        int first = (order == BACK_TO_FRONT) ? farther : nearer;
+        int last  = (order == BACK_TO_FRONT) ? nearer : farther;
+        // pushed in reverse order of processing
+        if (last >= 0) stack.push_back(last);
+        stack.push_back(-(i+1));
+        if (first >= 0) stack.push_back(first);
+    }
+}
+
+/**
+ * Get the node of a leaf id.
+ *
+ * @param leaf Leaf id from LocatePoints.
+ * @return Index of the node the leaf belongs to.
+ */
+int CompiledBSP::GetLeafNode(int leaf) {
+    return leaf >> 1;
+}
+
+/**
+ * Check if a leaf id is the empty back cell of its node.
+ *
+ * @param leaf Leaf id from LocatePoints.
+ * @return True for the back cell, false for the front cell or the
+ *         node itself if it is a leaf node.
+ */
+bool CompiledBSP::IsBackLeaf(int leaf) {
+    return leaf & 1;
+}
+
+/**
+ * Locate the leaves containing a batch of points.
+ *
+ * The leaf of a point is either a leaf node or the empty front or
+ * back cell below a node without a child on that side. It is encoded
+ * as twice the node index, plus one for back cells; see GetLeafNode
+ * and IsBackLeaf. Points in a dividing plane belong to the front.
+ *
+ * All points are pushed down the tree together. At each node the
+ * pending points are partitioned in place by the plane, so every
+ * node is read once per batch rather than once per point.
+ *
+ * @param points Points to locate.
+ * @param count Number of points.
+ * @param[out] leaves Leaf id of each point, -1 if the tree is empty.
+ */
+void CompiledBSP::LocatePoints(const Vector<3,float>* points, unsigned int count,
+                               int* leaves) const {
+    if (count == 0) return;
+    if (nodeCount == 0) {
+        for (unsigned int i = 0; i < count; i++) leaves[i] = -1;
+        return;
+    }
+    std::vector<unsigned int> index(count);
+    for (unsigned int i = 0; i < count; i++) index[i] = i;
+    std::vector<BSPPointRange> stack;
+    BSPPointRange r = { 0, 0, count };
+    stack.push_back(r);
+    while (!stack.empty()) {
+        r = stack.back();
+        stack.pop_back();
+        const Node& n = nodes[r.node];
+        if (IsLeaf(r.node)) {
+            for (unsigned int i = r.begin; i < r.end; i++)
+                leaves[index[i]] = r.node << 1;
+            continue;
+        }
+        // partition the range into front points and back points
+        unsigned int mid = r.begin, last = r.end;
+        while (mid < last) {
+            const Vector<3,float>& p = points[index[mid]];
+            if (n.plane[0]*p[0] + n.plane[1]*p[1] + n.plane[2]*p[2] >= n.plane[3])
+                mid++;
+            else {
+                unsigned int tmp = index[mid];
+                index[mid] = index[--last];
+                index[last] = tmp;
+            }
+        }
+        if (mid > r.begin) {
+            if (n.front < 0)
+                for (unsigned int i = r.begin; i < mid; i++)
+                    leaves[index[i]] = r.node << 1;
+            else {
+                BSPPointRange f = { n.front, r.begin, mid };
+                stack.push_back(f);
+            }
+        }
+        if (r.end > mid) {
+            if (n.back < 0)
+                for (unsigned int i = mid; i < r.end; i++)
+                    leaves[index[i]] = (r.node << 1) | 1;
+            else {
+                BSPPointRange b = { n.back, mid, r.end };
+                stack.push_back(b);
+            }
+        }
+    }
+}
+
+/**
+ * Intersect a ray with the faces of a node, keeping the nearest hit.
+ * Uses the Moeller-Trumbore test, faces are hit from both sides.
+ */
+bool CompiledBSP::IntersectFaces(const Ray& ray, const Node& node, RayHit& hit) const {
+    bool found = false;
+    const Vector<3,float>& o = ray.origin;
+    const Vector<3,float>& d = ray.direction;
+    for (unsigned int f = node.first; f < node.first + node.count; f++) {
+        const float* v = &vertices[indices[f*3]*3];
+        const float* v1 = &vertices[indices[f*3+1]*3];
+        const float* v2 = &vertices[indices[f*3+2]*3];
+        float e1[3] = { v1[0]-v[0], v1[1]-v[1], v1[2]-v[2] };
+        float e2[3] = { v2[0]-v[0], v2[1]-v[1], v2[2]-v[2] };
+        float p[3] = { d[1]*e2[2] - d[2]*e2[1],
+                       d[2]*e2[0] - d[0]*e2[2],
+                       d[0]*e2[1] - d[1]*e2[0] };
+        float det = e1[0]*p[0] + e1[1]*p[1] + e1[2]*p[2];
+        if (det > -1e-12f && det < 1e-12f) continue;
+        float inv = 1.0f / det;
+        float s[3] = { o[0]-v[0], o[1]-v[1], o[2]-v[2] };
+        float u = (s[0]*p[0] + s[1]*p[1] + s[2]*p[2]) * inv;
+        if (u < 0 || u > 1) continue;
+        float q[3] = { s[1]*e1[2] - s[2]*e1[1],
+                       s[2]*e1[0] - s[0]*e1[2],
+                       s[0]*e1[1] - s[1]*e1[0] };
+        float w = (d[0]*q[0] + d[1]*q[1] + d[2]*q[2]) * inv;
+        if (w < 0 || u + w > 1) continue;
+        float t = (e2[0]*q[0] + e2[1]*q[1] + e2[2]*q[2]) * inv;
+        if (t < 0 || t > ray.length) continue;
+        if (hit.face < 0 || t < hit.distance) {
+            hit.face = f;
+            hit.distance = t;
+            found = true;
+        }
+    }
+    return found;
+}
+
+/**
+ * Find the first face hit by each of a batch of rays.
+ *
+ * The rays are pushed down the tree together as segments. At each
+ * node the segments of the node are partitioned by the dividing
+ * plane into those staying on one side, which move on whole, and
+ * those crossing it, which are tested against the faces in the plane
+ * and split in a near part and a far part. The near segments of both
+ * children are visited before the far ones, and a segment starting
+ * beyond the nearest hit found so far for its ray is dropped, so
+ * rays stop descending once they have hit something.
+ *
+ * The segments live on one stack shared by all nodes: the range of
+ * the node being visited is always at its top and is replaced by the
+ * ranges of the children.
+ *
+ * @param rays Rays to cast.
+ * @param count Number of rays.
+ * @param[out] hits Nearest hit of each ray.
+ */
+void CompiledBSP::CastRays(const Ray* rays, unsigned int count, RayHit* hits) const {
+    for (unsigned int r = 0; r < count; r++) {
+        hits[r].face = -1;
+        hits[r].distance = rays[r].length;
+    }
+    if (nodeCount == 0 || count == 0) return;
+
+    std::vector<BSPRaySegment> segments;
+    segments.reserve(count * 2);
+    for (unsigned int r = 0; r < count; r++) {
+        BSPRaySegment s = { r, 0, rays[r].length };
+        segments.push_back(s);
+    }
+    std::vector<BSPRayRange> stack;
+    BSPRayRange root = { 0, 0, count };
+    stack.push_back(root);
+
+    // near front, near back, far front and far back segments
+    std::vector<BSPRaySegment> groups[4];
+    while (!stack.empty()) {
+        BSPRayRange range = stack.back();
+        stack.pop_back();
+        const Node& n = nodes[range.node];
+        if (IsLeaf(range.node)) {
+            for (unsigned int i = range.begin; i < range.end; i++) {
+                const BSPRaySegment& s = segments[i];
+                RayHit& hit = hits[s.ray];
+                if (hit.face < 0 || hit.distance > s.tmin)
+                    IntersectFaces(rays[s.ray], n, hit);
+            }
+            segments.resize(range.begin);
+            continue;
+        }
+
+        for (unsigned int g = 0; g < 4; g++) groups[g].clear();
+        for (unsigned int i = range.begin; i < range.end; i++) {
+            BSPRaySegment s = segments[i];
+            const Ray& ray = rays[s.ray];
+            RayHit& hit = hits[s.ray];
+            // nothing in the segment can be nearer than the hit
+            if (hit.face >= 0) {
+                if (hit.distance <= s.tmin) continue;
+                if (hit.distance < s.tmax) s.tmax = hit.distance;
+            }
+            float dist = n.plane[0]*ray.origin[0] + n.plane[1]*ray.origin[1]
+                + n.plane[2]*ray.origin[2] - n.plane[3];
+            float denom = n.plane[0]*ray.direction[0] + n.plane[1]*ray.direction[1]
+                + n.plane[2]*ray.direction[2];
+            unsigned int nearer = (dist >= 0) ? 0 : 1;
+            float t = (denom != 0) ? -dist / denom : -1;
+            if (t < 0 || t > s.tmax)
+                // the segment stays on the near side
+                groups[nearer].push_back(s);
+            else if (t < s.tmin)
+                // the ray crossed the plane before the segment
+                groups[1 - nearer].push_back(s);
+            else {
+                // the segment crosses the plane
+                IntersectFaces(ray, n, hit);
+                BSPRaySegment far = { s.ray, t, s.tmax };
+                s.tmax = t;
+                groups[nearer].push_back(s);
+                groups[3 - nearer].push_back(far);
+            }
+        }
+
+        // replace the range by the groups, far ones deepest in the stack
+        segments.resize(range.begin);
+        static const unsigned int push_order[4] = { 2, 3, 0, 1 };
+        for (unsigned int k = 0; k < 4; k++) {
+            unsigned int g = push_order[k];
+            int child = (g % 2 == 0) ? n.front : n.back;
+            if (groups[g].empty() || child < 0) continue;
+            BSPRayRange sub = { child, (unsigned int)segments.size(), 0 };
+            segments.insert(segments.end(), groups[g].begin(), groups[g].end());
+            sub.end = (unsigned int)segments.size();
+            stack.push_back(sub);
+        }
+    }
+}
+
+} // NS Scene
+} // NS OpenEngine
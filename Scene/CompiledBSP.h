@@ -0,0 +1,159 @@
+// Flattened BSP tree.
+// -------------------------------------------------------------------
+// Copyright (C) 2007 OpenEngine.dk (See AUTHORS) 
+// 
+// This program is free software; It is covered by the GNU General 
+// Public License version 2 or any later version. 
+// See the GNU General Public License for more details (see LICENSE). 
+//--------------------------------------------------------------------
+
+#ifndef _OE_COMPILED_BSP_H_
+#define _OE_COMPILED_BSP_H_
+
+#include <Geometry/FaceSet.h>
+#include <Scene/TreeFile.h>
+#include <string>
+#include <vector>
+
+namespace OpenEngine {
+namespace Scene {
+
+class BSPNode;
+
+using namespace OpenEngine::Geometry;
+
+/**
+ * Flattened BSP tree.
+ *
+ * A built BSPNode tree compiled into one contiguous array of nodes.
+ * Each node holds its dividing plane as four floats, the indices of
+ * its children and a range into a packed face array holding the
+ * faces of its span (or all faces of a leaf).
+ *
+ * Nodes are stored in depth first order with the front child
+ * immediately after its parent, so queries walk the array mostly
+ * forward and never touch the faces unless they need them.
+ *
+ * @code
+ * CompiledBSP bsp(root);
+ * // render the faces back to front as seen from the camera
+ * std::vector<unsigned int> order;
+ * bsp.Traverse(camera->GetPosition(), CompiledBSP::BACK_TO_FRONT, order);
+ * @endcode
+ *
+ * Point location and ray casts are answered in batches. Points and
+ * rays are pushed down the tree together, partitioned by each plane
+ * they meet. Rays crossing a plane are split, visiting the near side
+ * first, so a ray stops descending once it has hit a face.
+ *
+ * @code
+ * CompiledBSP::Ray rays[n];
+ * CompiledBSP::RayHit hits[n];
+ * bsp.CastRays(rays, n, hits);
+ * @endcode
+ *
+ * The geometry is kept as a vertex block, an attribute block of
+ * normals, texture coordinates and colors, an index block of three
+ * vertex indices per face and a material table index per face. A
+ * compiled tree can be saved to a TreeFile and loaded in place from
+ * it, so loading a level does not allocate per node or face. Loaded
+ * trees have no Face objects. They are rendered from the blocks with
+ * the material table of the saved tree, given to SetMaterials().
+ *
+ * @code
+ * bsp.Save("level.bsp");
+ * // ... at startup
+ * CompiledBSP level;
+ * level.Load("level.bsp");
+ * level.SetMaterials(materials);
+ * @endcode
+ *
+ * @see TreeGeometry
+ *
+ * @class CompiledBSP CompiledBSP.h Scene/CompiledBSP.h
+ */
+class CompiledBSP : public TreeGeometry {
+public:
+    /**
+     * Compiled node, 32 bytes.
+     */
+    struct Node {
+        float plane[4];      //!< plane a*x + b*y + c*z = d, zero for leaves
+        int front;           //!< index of the front child, -1 if none
+        int back;            //!< index of the back child, -1 if none
+        unsigned int first;  //!< first face in the packed face array
+        unsigned int count;  //!< number of faces of the node
+    };
+
+    /**
+     * Ray for ray casts.
+     * Distances are measured in multiples of the direction vector, so
+     * with a normalized direction they are world distances.
+     */
+    struct Ray {
+        Vector<3,float> origin;     //!< start of the ray
+        Vector<3,float> direction;  //!< direction of the ray
+        float length;               //!< maximum hit distance
+    };
+
+    /**
+     * Result of a ray cast.
+     */
+    struct RayHit {
+        int face;        //!< index of the face hit, -1 if nothing was hit
+        float distance;  //!< distance along the ray to the hit
+    };
+
+    //! Traversal orders relative to a viewpoint.
+    enum Order {
+        BACK_TO_FRONT,  //!< farthest faces first
+        FRONT_TO_BACK   //!< nearest faces first
+    };
+
+private:
+    // storage of compiled trees, loaded trees use the file
+    std::vector<Node> nodeStore;
+
+    // the node array in use
+    const Node* nodes;
+    unsigned int nodeCount;
+
+    // not copyable
+    CompiledBSP(const CompiledBSP&);
+    CompiledBSP& operator=(const CompiledBSP&);
+
+    bool IntersectFaces(const Ray& ray, const Node& node, RayHit& hit) const;
+
+public:
+    CompiledBSP();
+    explicit CompiledBSP(BSPNode* root);
+    ~CompiledBSP();
+
+    void Compile(BSPNode* root);
+    void Clear();
+
+    void Save(const std::string& filename) const;
+    void Load(const std::string& filename, bool verify = true);
+
+    unsigned int GetNodeCount() const;
+    const Node& GetNode(unsigned int index) const;
+
+    bool IsLeaf(unsigned int index) const;
+    int ComparePoint(unsigned int index, const Vector<3,float>& point,
+                     float epsilon = EPS) const;
+
+    void Traverse(const Vector<3,float>& viewpoint, Order order,
+                  std::vector<unsigned int>& result) const;
+
+    void LocatePoints(const Vector<3,float>* points, unsigned int count,
+                      int* leaves) const;
+    void CastRays(const Ray* rays, unsigned int count, RayHit* hits) const;
+
+    static int GetLeafNode(int leaf);
+    static bool IsBackLeaf(int leaf);
+};
+
+} // NS Scene
+} // NS OpenEngine
+
+#endif // _OE_COMPILED_BSP_H_
@@ -0,0 +1,241 @@
+// Flattened quad tree.
+// -------------------------------------------------------------------
+// Copyright (C) 2007 OpenEngine.dk (See AUTHORS)
+//
+// This program is free software; It is covered by the GNU General
+// Public License version 2 or any later version.
+// See the GNU General Public License for more details (see LICENSE).
+//--------------------------------------------------------------------
+
+#include <Scene/CompiledQuadTree.h>
+#include <Scene/QuadNode.h>
+#include <Scene/GeometryNode.h>
+#include <Scene/TreeFile.h>
+#include <Scene/LeafPager.h>
+#include <Core/Exceptions.h>
+#include <Display/IViewingVolume.h>
+
+namespace OpenEngine {
+namespace Scene {
+
+// pending node of the compilation with the index of its parent
+struct QuadCompileItem {
+    QuadNode* node;
+    int parent;
+    int slot;
+};
+
+/**
+ * Create an empty compiled tree.
+ */
+CompiledQuadTree::CompiledQuadTree()
+    : nodes(NULL), nodeCount(0) {
+
+}
+
+/**
+ * Compile a quad tree.
+ *
+ * @param root Root of the tree to compile.
+ * @param pager Store of the leaves of a paged tree.
+ */
+CompiledQuadTree::CompiledQuadTree(QuadNode* root, LeafPager* pager)
+    : nodes(NULL), nodeCount(0) {
+    Compile(root, pager);
+}
+
+/**
+ * Destructor.
+ */
+CompiledQuadTree::~CompiledQuadTree() {
+
+}
+
+/**
+ * Compile a quad tree, replacing the current contents.
+ * The faces are shared with the source tree, which may be deleted
+ * afterwards. The leaves of a tree built with a LeafPager hold no
+ * faces, they are read from the pager instead.
+ *
+ * @param root Root of the tree to compile, may be NULL.
+ * @param pager Store of the leaves of a paged tree, opened for
+ *              paging. May be NULL if the tree has no paged leaves.
+ * @throws Exception if the tree has paged leaves and no pager is
+ *         given, or ResourceException if a page cannot be read. The
+ *         compiled tree is empty afterwards.
+ */
+void CompiledQuadTree::Compile(QuadNode* root, LeafPager* pager) {
+    Clear();
+    if (root == NULL) return;
+    try {
+        CompileNodes(root, pager);
+    } catch (...) {
+        Clear();
+        throw;
+    }
+    Pack();
+
+    nodes = &nodeStore[0];
+    nodeCount = nodeStore.size();
+}
+
+/**
+ * Compile the nodes depth first and add their faces to the blocks.
+ */
+void CompiledQuadTree::CompileNodes(QuadNode* root, LeafPager* pager) {
+    unsigned int packed = 0;
+    std::vector<QuadCompileItem> stack;
+    QuadCompileItem p = { root, -1, 0 };
+    stack.push_back(p);
+    while (!stack.empty()) {
+        p = stack.back();
+        stack.pop_back();
+        QuadNode* quad = p.node;
+        int index = nodeStore.size();
+        if (p.parent >= 0)
+            nodeStore[p.parent].child[p.slot] = index;
+
+        Node n;
+        Box bb = quad->GetBoundingBox();
+        Vector<3,float> center = bb.GetCenter();
+        Vector<3,float> corner = bb.GetCorner();
+        for (unsigned int i = 0; i < 3; i++) {
+            n.center[i] = center[i];
+            n.corner[i] = corner[i];
+        }
+        n.child[0] = n.child[1] = n.child[2] = n.child[3] = -1;
+        n.first = packed;
+        for (list<ISceneNode*>::iterator itr = quad->subNodes.begin();
+             itr != quad->subNodes.end(); itr++) {
+            GeometryNode* geom = dynamic_cast<GeometryNode*>(*itr);
+            if (!geom) continue;
+            FaceSet* set = geom->GetFaceSet();
+            for (FaceList::iterator f = set->begin(); f != set->end(); f++) {
+                AddFace(*f);
+                packed++;
+            }
+        }
+        if (quad->GetPage() >= 0) {
+            if (!pager)
+                throw Core::Exception("Paged quad tree compiled without its leaf pager.");
+            FaceSet* set = pager->Load(quad->GetPage());
+            for (FaceList::iterator f = set->begin(); f != set->end(); f++) {
+                AddFace(*f);
+                packed++;
+            }
+            delete set;
+        }
+        n.count = packed - n.first;
+        nodeStore.push_back(n);
+
+        // pushed in reverse order so the top left child is next
+        QuadNode* children[4] = { quad->GetTopLeft(), quad->GetTopRight(),
+                                  quad->GetBottomLeft(), quad->GetBottomRight() };
+        for (int i = 3; i >= 0; i--)
+            if (children[i]) {
+                QuadCompileItem c = { children[i], index, i };
+                stack.push_back(c);
+            }
+    }
+}
+
+/**
+ * Remove all nodes, faces and materials, and release a loaded file.
+ */
+void CompiledQuadTree::Clear() {
+    ClearGeometry();
+    nodeStore.clear();
+    nodes = NULL;
+    nodeCount = 0;
+}
+
+/**
+ * Save the tree to a file.
+ * The materials are saved as indices into the material table, see
+ * GetMaterials().
+ *
+ * @param filename File to write.
+ * @throws ResourceException if the file cannot be written.
+ * @see TreeFile
+ */
+void CompiledQuadTree::Save(const std::string& filename) const {
+    SaveFile(filename, TreeFile::QUAD_TREE, sizeof(Node), nodes, nodeCount);
+}
+
+/**
+ * Load a tree from a file, replacing the current contents.
+ * The file is used in place until the tree is cleared or deleted.
+ * The loaded tree has no materials until they are set with
+ * SetMaterials().
+ *
+ * @param filename File to read.
+ * @param verify Check the checksum of the file.
+ * @throws ResourceException if the file does not hold a quad tree.
+ * @see TreeFile
+ */
+void CompiledQuadTree::Load(const std::string& filename, bool verify) {
+    Clear();
+    nodes = (const Node*)LoadFile(filename, TreeFile::QUAD_TREE, sizeof(Node),
+                                  verify, nodeCount);
+}
+
+/**
+ * Get the number of nodes.
+ * The root is node 0 if the tree is non-empty.
+ *
+ * @return Node count.
+ */
+unsigned int CompiledQuadTree::GetNodeCount() const {
+    return nodeCount;
+}
+
+/**
+ * Get a node.
+ *
+ * @param index Node index.
+ * @return Compiled node.
+ */
+const CompiledQuadTree::Node& CompiledQuadTree::GetNode(unsigned int index) const {
+    return nodes[index];
+}
+
+/**
+ * Get the bounding box of a node.
+ *
+ * @param index Node index.
+ * @return Bounding box.
+ */
+Box CompiledQuadTree::GetBoundingBox(unsigned int index) const {
+    const Node& n = nodes[index];
+    return Box(Vector<3,float>(n.center[0], n.center[1], n.center[2]),
+               Vector<3,float>(n.corner[0], n.corner[1], n.corner[2]));
+}
+
+/**
+ * Find the visible nodes holding faces.
+ * Sub trees are skipped when their bounding box is outside the
+ * viewing volume.
+ *
+ * @param volume Viewing volume.
+ * @param[out] result Indices of the visible nodes with faces, in tree
+ *                    order. The vector is cleared first.
+ */
+void CompiledQuadTree::Cull(Display::IViewingVolume& volume,
+                            std::vector<unsigned int>& result) const {
+    result.clear();
+    if (nodeCount == 0) return;
+    std::vector<int> stack;
+    stack.push_back(0);
+    while (!stack.empty()) {
+        int i = stack.back();
+        stack.pop_back();
+        if (!volume.IsVisible(GetBoundingBox(i))) continue;
+        const Node& n = nodes[i];
+        if (n.count) result.push_back(i);
+        for (int c = 3; c >= 0; c--)
+            if (n.child[c] >= 0) stack.push_back(n.child[c]);
+    }
+}
+
+} // NS Scene
+} // NS OpenEngine
@@ -0,0 +1,111 @@
+// Flattened quad tree.
+// -------------------------------------------------------------------
+// Copyright (C) 2007 OpenEngine.dk (See AUTHORS)
+//
+// This program is free software; It is covered by the GNU General
+// Public License version 2 or any later version.
+// See the GNU General Public License for more details (see LICENSE).
+//--------------------------------------------------------------------
+
+#ifndef _OE_COMPILED_QUAD_TREE_H_
+#define _OE_COMPILED_QUAD_TREE_H_
+
+#include <Geometry/FaceSet.h>
+#include <Scene/TreeFile.h>
+#include <Geometry/Box.h>
+#include <string>
+#include <vector>
+
+namespace OpenEngine {
+    namespace Display {
+        class IViewingVolume;
+    }
+namespace Scene {
+
+class QuadNode;
+class LeafPager;
+
+using namespace OpenEngine::Geometry;
+
+/**
+ * Flattened quad tree.
+ *
+ * A built QuadNode tree compiled into one contiguous array of nodes
+ * in depth first order. Each node holds its bounding box, the indices
+ * of its four children and a range into a packed face array holding
+ * the faces of its geometry sub nodes. Like CompiledBSP the geometry
+ * is kept as vertex, attribute, index and material blocks and the
+ * tree can be saved to a TreeFile and loaded in place from it. A
+ * loaded tree draws the faces of the visible nodes from the blocks,
+ * with the material table of the saved tree given to SetMaterials().
+ * Trees built with a LeafPager are compiled with the pages read
+ * through the pager, so the compiled tree holds all leaf geometry.
+ *
+ * @code
+ * CompiledQuadTree quad(root);
+ * quad.Save("level.quad");
+ * // ... at startup
+ * CompiledQuadTree level;
+ * level.Load("level.quad");
+ * level.SetMaterials(materials);
+ * std::vector<unsigned int> visible;
+ * level.Cull(*viewingVolume, visible);
+ * @endcode
+ *
+ * @see CompiledBSP
+ * @see TreeFile
+ * @see TreeGeometry
+ *
+ * @class CompiledQuadTree CompiledQuadTree.h Scene/CompiledQuadTree.h
+ */
+class CompiledQuadTree : public TreeGeometry {
+public:
+    /**
+     * Compiled node, 48 bytes.
+     */
+    struct Node {
+        float center[3];     //!< center of the bounding box
+        float corner[3];     //!< relative corner of the bounding box
+        int child[4];        //!< top left, top right, bottom left and
+                             //!< bottom right child, -1 if none
+        unsigned int first;  //!< first face in the packed face array
+        unsigned int count;  //!< number of faces of the node
+    };
+
+private:
+    // storage of compiled trees, loaded trees use the file
+    std::vector<Node> nodeStore;
+
+    // the node array in use
+    const Node* nodes;
+    unsigned int nodeCount;
+
+    // not copyable
+    CompiledQuadTree(const CompiledQuadTree&);
+    CompiledQuadTree& operator=(const CompiledQuadTree&);
+
+    void CompileNodes(QuadNode* root, LeafPager* pager);
+
+public:
+    CompiledQuadTree();
+    explicit CompiledQuadTree(QuadNode* root, LeafPager* pager = NULL);
+    ~CompiledQuadTree();
+
+    void Compile(QuadNode* root, LeafPager* pager = NULL);
+    void Clear();
+
+    void Save(const std::string& filename) const;
+    void Load(const std::string& filename, bool verify = true);
+
+    unsigned int GetNodeCount() const;
+    const Node& GetNode(unsigned int index) const;
+    Box GetBoundingBox(unsigned int index) const;
+
+    void Cull(Display::IViewingVolume& volume,
+              std::vector<unsigned int>& result) const;
+};
+
+} // NS Scene
+} // NS OpenEngine
+
+#endif // _OE_COMPILED_QUAD_TREE_H_
@@ -0,0 +1,108 @@
+// Frustum planes for hierarchical culling.
+// -------------------------------------------------------------------
+// Copyright (C) 2007 OpenEngine.dk (See AUTHORS)
+//
+// This program is free software; It is covered by the GNU General
+// Public License version 2 or any later version.
+// See the GNU General Public License for more details (see LICENSE).
+//--------------------------------------------------------------------
+
+#include <Scene/CullingPlanes.h>
+#include <Display/IViewingVolume.h>
+#include <cmath>
+
+namespace OpenEngine {
+namespace Scene {
+
+/**
+ * Create planes accepting everything, until extracted.
+ */
+CullingPlanes::CullingPlanes() {
+    for (unsigned int i = 0; i < 6; i++) {
+        planes[i][0] = planes[i][1] = planes[i][2] = 0;
+        planes[i][3] = 1;
+    }
+}
+
+/**
+ * Create the planes of a viewing volume.
+ *
+ * @param volume Viewing volume.
+ */
+CullingPlanes::CullingPlanes(Display::IViewingVolume& volume) {
+    Extract(volume);
+}
+
+/**
+ * Extract the planes of a viewing volume.
+ *
+ * @param volume Viewing volume.
+ */
+void CullingPlanes::Extract(Display::IViewingVolume& volume) {
+    Extract(volume.GetViewMatrix() * volume.GetProjectionMatrix());
+}
+
+/**
+ * Extract the planes of a view projection matrix.
+ * The matrix transforms row vectors, as the matrices of the viewing
+ * volumes do. The planes are normalized and point inwards, in the
+ * order left, right, bottom, top, near and far.
+ *
+ * @param m View matrix times projection matrix.
+ */
+void CullingPlanes::Extract(const Matrix<4,4,float>& m) {
+    for (unsigned int i = 0; i < 3; i++) {
+        for (unsigned int j = 0; j < 4; j++) {
+            planes[2*i][j]   = m(j,3) + m(j,i);
+            planes[2*i+1][j] = m(j,3) - m(j,i);
+        }
+    }
+    for (unsigned int i = 0; i < 6; i++) {
+        float* p = planes[i];
+        float len = std::sqrt(p[0]*p[0] + p[1]*p[1] + p[2]*p[2]);
+        if (len == 0) continue;
+        for (unsigned int j = 0; j < 4; j++)
+            p[j] /= len;
+    }
+}
+
+/**
+ * Test a box against the planes of a mask.
+ *
+ * The hint plane is tested first, then the remaining planes of the
+ * mask. Planes the box is entirely inside of are removed from the
+ * mask, so the mask can be passed on to the boxes contained in this
+ * one. A mask of zero accepts every box without tests.
+ *
+ * @param box Box to test.
+ * @param[in,out] mask Planes to test, reduced to the planes
+ *                     intersecting the box if it is visible.
+ * @param[in,out] hint Plane to test first, set to the rejecting
+ *                     plane if the box is outside.
+ * @return True if the box is at least partly inside.
+ */
+bool CullingPlanes::Test(const Box& box, unsigned int& mask,
+                         unsigned int& hint) const {
+    if (mask == 0) return true;
+    Vector<3,float> c = box.GetCenter();
+    Vector<3,float> e = box.GetCorner();
+    unsigned int first = (hint < 6) ? hint : 0;
+    for (unsigned int k = 0; k < 6; k++) {
+        unsigned int i = (k == 0) ? first : ((k <= first) ? k - 1 : k);
+        unsigned int bit = 1 << i;
+        if (!(mask & bit)) continue;
+        const float* p = planes[i];
+        float d = p[0]*c[0] + p[1]*c[1] + p[2]*c[2] + p[3];
+        float r = std::fabs(p[0]*e[0]) + std::fabs(p[1]*e[1])
+            + std::fabs(p[2]*e[2]);
+        if (d + r < 0) {
+            hint = i;
+            return false;
+        }
+        if (d - r >= 0) mask &= ~bit;
+    }
+    return true;
+}
+
+} // NS Scene
+} // NS OpenEngine
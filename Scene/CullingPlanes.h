@@ -0,0 +1,69 @@
+// Frustum planes for hierarchical culling.
+// -------------------------------------------------------------------
+// Copyright (C) 2007 OpenEngine.dk (See AUTHORS)
+//
+// This program is free software; It is covered by the GNU General
+// Public License version 2 or any later version.
+// See the GNU General Public License for more details (see LICENSE).
+//--------------------------------------------------------------------
+
+#ifndef _OE_CULLING_PLANES_H_
+#define _OE_CULLING_PLANES_H_
+
+#include <Geometry/Box.h>
+#include <Math/Matrix.h>
+
+namespace OpenEngine {
+    namespace Display {
+        class IViewingVolume;
+    }
+namespace Scene {
+
+using namespace OpenEngine::Geometry;
+
+/**
+ * Frustum planes for hierarchical culling.
+ *
+ * The six planes of a viewing volume, extracted from the product of
+ * its view and projection matrix. Boxes are tested against a mask of
+ * the planes that still need testing. A box entirely on the inside
+ * of a plane clears its bit, so the sub tree of a box with an empty
+ * mask is known to be inside without further tests.
+ *
+ * A hint holds the plane that rejected a box last. It is tested
+ * first, as a box that was outside in the last frame is most likely
+ * outside the same plane in this one.
+ *
+ * @code
+ * CullingPlanes planes(*viewingVolume);
+ * unsigned int mask = CullingPlanes::ALL_PLANES;
+ * unsigned int hint = 0;
+ * if (planes.Test(box, mask, hint)) {
+ *     // visible, pass mask on to the children
+ * }
+ * @endcode
+ *
+ * @class CullingPlanes CullingPlanes.h Scene/CullingPlanes.h
+ */
+class CullingPlanes {
+public:
+    //! Mask of all six planes.
+    static const unsigned int ALL_PLANES = 0x3f;
+
+private:
+    float planes[6][4];
+
+public:
+    CullingPlanes();
+    explicit CullingPlanes(Display::IViewingVolume& volume);
+
+    void Extract(Display::IViewingVolume& volume);
+    void Extract(const Matrix<4,4,float>& viewProjection);
+
+    bool Test(const Box& box, unsigned int& mask, unsigned int& hint) const;
+};
+
+} // NS Scene
+} // NS OpenEngine
+
+#endif // _OE_CULLING_PLANES_H_
@@ -0,0 +1,451 @@
+// Paged on-disk store of tree leaves.
+// -------------------------------------------------------------------
+// Copyright (C) 2007 OpenEngine.dk (See AUTHORS)
+//
+// This program is free software; It is covered by the GNU General
+// Public License version 2 or any later version.
+// See the GNU General Public License for more details (see LICENSE).
+//--------------------------------------------------------------------
+
+// 64 bit file offsets also on 32 bit systems, before any system header
+#ifndef _WIN32
+#define _FILE_OFFSET_BITS 64
+#endif
+
+#include <Scene/LeafPager.h>
+#include <Scene/GeometryNode.h>
+#include <Core/Exceptions.h>
+
+#ifndef _WIN32
+#include <sys/types.h>
+#endif
+
+namespace OpenEngine {
+namespace Scene {
+
+using OpenEngine::Core::ResourceException;
+
+// seek to a 64 bit file offset
+static bool Seek(FILE* file, long long offset, int whence) {
+#ifdef _WIN32
+    return _fseeki64(file, offset, whence) == 0;
+#else
+    return fseeko(file, (off_t)offset, whence) == 0;
+#endif
+}
+
+// get the 64 bit file offset, negative on errors
+static long long Tell(FILE* file) {
+#ifdef _WIN32
+    return _ftelli64(file);
+#else
+    return ftello(file);
+#endif
+}
+
+// floats per face: vertices, normals, texture coordinates, colors
+// and the hard normal
+static const unsigned int face_floats = 9 + 9 + 6 + 12 + 3;
+
+// material index of faces without a material
+static const unsigned int no_material = 0xffffffff;
+
+// magic of the trailer ending a store
+static const unsigned int trailer_magic = 0x504c454f; // "OELP"
+
+/**
+ * Task loading a page on the loader thread.
+ */
+class LeafPager::LoadTask : public Core::ITask {
+private:
+    LeafPager* pager;
+    unsigned int page;
+public:
+    LoadTask(LeafPager* pager, unsigned int page)
+        : pager(pager), page(page) {}
+    void Run(Core::WorkStealingPool& pool, unsigned int worker) {
+        Loaded l;
+        l.page = page;
+        l.faces = pager->Read(page);
+        pager->lock.Lock();
+        pager->loaded.push_back(l);
+        pager->lock.Unlock();
+    }
+};
+
+/**
+ * Create a pager without a store.
+ */
+LeafPager::LeafPager()
+    : file(NULL), writing(false), budget(64 << 20), resident(0)
+    , update(0), loader(NULL) {
+
+}
+
+/**
+ * Destructor, waits for outstanding loads and releases all pages.
+ */
+LeafPager::~LeafPager() {
+    Reset();
+}
+
+/**
+ * Wait for the loads, release the pages and close the file.
+ * The materials are kept.
+ */
+void LeafPager::Reset() {
+    if (loader) {
+        loader->Wait(loads, loader->GetExternalWorker());
+        delete loader;
+        loader = NULL;
+    }
+    for (unsigned int i = 0; i < loaded.size(); i++)
+        delete loaded[i].faces;
+    loaded.clear();
+    for (unsigned int i = 0; i < pages.size(); i++)
+        delete pages[i].node;
+    pages.clear();
+    lru.clear();
+    resident = 0;
+    if (file) fclose(file);
+    file = NULL;
+    writing = false;
+}
+
+/**
+ * Create a new store for writing, replacing any open store.
+ * The materials of earlier stores are kept.
+ *
+ * @param filename File to write.
+ * @throws ResourceException if the file cannot be created.
+ */
+void LeafPager::Create(const std::string& filename) {
+    Reset();
+    file = fopen(filename.c_str(), "wb");
+    if (!file)
+        throw ResourceException("Could not create page file: " + filename);
+    writing = true;
+}
+
+/**
+ * Write the faces of a leaf to a new page.
+ *
+ * @param faces Faces to write.
+ * @return Page index.
+ * @throws ResourceException if the store is not open for writing or
+ *         the page cannot be written.
+ */
+unsigned int LeafPager::Write(FaceSet& faces) {
+    std::vector<float> data;
+    std::vector<unsigned int> mats;
+    data.reserve(faces.Size() * face_floats);
+    lock.Lock();
+    if (!writing) {
+        lock.Unlock();
+        throw ResourceException("Page file not open for writing.");
+    }
+    for (FaceList::iterator itr = faces.begin(); itr != faces.end(); itr++) {
+        Face& f = **itr;
+        for (unsigned int v = 0; v < 3; v++) {
+            for (unsigned int c = 0; c < 3; c++) data.push_back(f.vert[v][c]);
+            for (unsigned int c = 0; c < 3; c++) data.push_back(f.norm[v][c]);
+            for (unsigned int c = 0; c < 2; c++) data.push_back(f.texc[v][c]);
+            for (unsigned int c = 0; c < 4; c++) data.push_back(f.colr[v][c]);
+        }
+        for (unsigned int c = 0; c < 3; c++) data.push_back(f.hardNorm[c]);
+        unsigned int id = no_material;
+        if (f.mat) {
+            std::map<Material*, unsigned int>::iterator m = materialIds.find(f.mat.get());
+            if (m == materialIds.end()) {
+                m = materialIds.insert(std::make_pair(f.mat.get(), (unsigned int)materials.size())).first;
+                materials.push_back(f.mat);
+            }
+            id = m->second;
+        }
+        mats.push_back(id);
+    }
+    long long offset = Tell(file);
+    Page p;
+    p.offset = offset;
+    p.faces = mats.size();
+    p.node = NULL;
+    p.requested = false;
+    p.used = 0;
+    bool ok = offset >= 0 && (p.faces == 0 ||
+        (fwrite(&mats[0], sizeof(unsigned int), mats.size(), file) == mats.size() &&
+         fwrite(&data[0], sizeof(float), data.size(), file) == data.size()));
+    unsigned int index = pages.size();
+    if (ok) pages.push_back(p);
+    lock.Unlock();
+    if (!ok) throw ResourceException("Could not write page.");
+    return index;
+}
+
+/**
+ * Finish a store by writing the page index after the pages. The
+ * trailer records the number of materials the faces refer to.
+ *
+ * @throws ResourceException if the index cannot be written.
+ */
+void LeafPager::Close() {
+    if (!writing) return;
+    bool ok = true;
+    for (unsigned int i = 0; i < pages.size(); i++) {
+        unsigned long long offset = pages[i].offset;
+        unsigned int faces = pages[i].faces;
+        ok = ok && fwrite(&offset, sizeof(offset), 1, file) == 1
+            && fwrite(&faces, sizeof(faces), 1, file) == 1;
+    }
+    unsigned int trailer[3] = { (unsigned int)materials.size(),
+                                (unsigned int)pages.size(), trailer_magic };
+    ok = ok && fwrite(trailer, sizeof(unsigned int), 3, file) == 3;
+    ok = (fclose(file) == 0) && ok;
+    file = NULL;
+    writing = false;
+    if (!ok) throw ResourceException("Could not write page index.");
+}
+
+/**
+ * Open a store for paging with the materials of the pager that wrote
+ * it, replacing any open store.
+ *
+ * @param filename File to read.
+ * @throws ResourceException if the file is not a page store, or
+ *         refers to materials this pager does not have.
+ */
+void LeafPager::Open(const std::string& filename) {
+    std::vector<MaterialPtr> mats(materials);
+    Open(filename, mats);
+}
+
+/**
+ * Open a store for paging, replacing any open store.
+ * Page faces refer to materials by their index in the table of the
+ * writing pager, see GetMaterials().
+ *
+ * @param filename File to read.
+ * @param materials Material table of the store.
+ * @throws ResourceException if the file is not a page store, or
+ *         refers to more materials than given.
+ */
+void LeafPager::Open(const std::string& filename,
+                     const std::vector<MaterialPtr>& materials) {
+    Reset();
+    this->materials = materials;
+    materialIds.clear();
+    for (unsigned int i = 0; i < materials.size(); i++)
+        materialIds.insert(std::make_pair(materials[i].get(), i));
+    file = fopen(filename.c_str(), "rb");
+    if (!file)
+        throw ResourceException("Could not open page file: " + filename);
+    unsigned int trailer[3] = { 0, 0, 0 };
+    bool ok = Seek(file, -(long long)sizeof(trailer), SEEK_END)
+        && fread(trailer, sizeof(unsigned int), 3, file) == 3
+        && trailer[2] == trailer_magic;
+    if (ok && trailer[0] > materials.size()) {
+        Reset();
+        throw ResourceException("Missing materials for page file: " + filename);
+    }
+    const long long entry = sizeof(unsigned long long) + sizeof(unsigned int);
+    ok = ok && Seek(file, -(long long)sizeof(trailer) - entry * trailer[1],
+                    SEEK_END);
+    for (unsigned int i = 0; ok && i < trailer[1]; i++) {
+        unsigned long long offset;
+        Page p;
+        ok = fread(&offset, sizeof(offset), 1, file) == 1
+            && fread(&p.faces, sizeof(p.faces), 1, file) == 1;
+        p.offset = offset;
+        p.node = NULL;
+        p.requested = false;
+        p.used = 0;
+        pages.push_back(p);
+    }
+    if (!ok) {
+        Reset();
+        throw ResourceException("Not a page file: " + filename);
+    }
+    loader = new Core::WorkStealingPool(1);
+}
+
+/**
+ * Read a page, called on the loader thread and by Load.
+ *
+ * @param page Page index.
+ * @return Faces of the page, NULL if they could not be read.
+ */
+FaceSet* LeafPager::Read(unsigned int page) {
+    unsigned int count = pages[page].faces;
+    std::vector<unsigned int> mats(count);
+    std::vector<float> data(count * face_floats);
+    lock.Lock();
+    bool ok = count == 0 ||
+        (Seek(file, pages[page].offset, SEEK_SET) &&
+         fread(&mats[0], sizeof(unsigned int), count, file) == count &&
+         fread(&data[0], sizeof(float), data.size(), file) == data.size());
+    lock.Unlock();
+    // fail the load on material indices outside the table
+    for (unsigned int i = 0; ok && i < count; i++)
+        ok = mats[i] == no_material || mats[i] < materials.size();
+    if (!ok) return NULL;
+
+    FaceSet* faces = new FaceSet();
+    const float* d = (count) ? &data[0] : NULL;
+    for (unsigned int i = 0; i < count; i++) {
+        Vector<3,float> v[3];
+        for (unsigned int j = 0; j < 3; j++)
+            v[j] = Vector<3,float>(d[j*12], d[j*12+1], d[j*12+2]);
+        FacePtr f(new Face(v[0], v[1], v[2]));
+        for (unsigned int j = 0; j < 3; j++, d += 12) {
+            f->norm[j] = Vector<3,float>(d[3], d[4], d[5]);
+            f->texc[j] = Vector<2,float>(d[6], d[7]);
+            f->colr[j] = Vector<4,float>(d[8], d[9], d[10], d[11]);
+        }
+        f->hardNorm = Vector<3,float>(d[0], d[1], d[2]);
+        d += 3;
+        if (mats[i] != no_material) f->mat = materials[mats[i]];
+        faces->Add(f);
+    }
+    return faces;
+}
+
+/**
+ * Get the material table of the pager. Faces written to a store
+ * refer to their material by index in this table, so a store is
+ * opened by another pager with the same table.
+ *
+ * @return Materials in index order.
+ */
+const std::vector<MaterialPtr>& LeafPager::GetMaterials() const {
+    return materials;
+}
+
+/**
+ * Set the memory budget of the resident pages.
+ * Pages used since the previous update are not evicted, so a frame
+ * needing more than the budget exceeds it instead of reloading pages
+ * every frame. The default is 64 MB.
+ *
+ * @param bytes Budget in bytes.
+ */
+void LeafPager::SetMemoryBudget(size_t bytes) {
+    budget = bytes;
+}
+
+/**
+ * Get the memory budget of the resident pages.
+ *
+ * @return Budget in bytes.
+ */
+size_t LeafPager::GetMemoryBudget() const {
+    return budget;
+}
+
+/**
+ * Get the estimated memory use of the resident pages.
+ *
+ * @return Size in bytes.
+ */
+size_t LeafPager::GetResidentSize() const {
+    return resident;
+}
+
+/**
+ * Get the number of pages.
+ *
+ * @return Page count.
+ */
+unsigned int LeafPager::GetPageCount() const {
+    return pages.size();
+}
+
+/**
+ * Read the faces of a page right away, bypassing the loader thread,
+ * the resident pages and the memory budget, for instance to compile a
+ * paged tree.
+ *
+ * @param page Page index.
+ * @return Faces of the page, owned by the caller.
+ * @throws ResourceException if no store is open for paging or the
+ *         page cannot be read.
+ */
+FaceSet* LeafPager::Load(unsigned int page) {
+    if (!file || writing || page >= pages.size())
+        throw ResourceException("Page not in an open page file.");
+    FaceSet* faces = Read(page);
+    if (!faces) throw ResourceException("Could not read page.");
+    return faces;
+}
+
+/**
+ * Get the geometry of a page.
+ * A page that is not resident is requested, and NULL is returned
+ * until an update after it has been loaded.
+ *
+ * @param page Page index.
+ * @return Geometry node owned by the pager, or NULL. The node stays
+ *         valid until the next update.
+ */
+GeometryNode* LeafPager::Get(unsigned int page) {
+    Page& p = pages[page];
+    if (!p.node) {
+        Request(page);
+        return NULL;
+    }
+    p.used = update;
+    lru.splice(lru.end(), lru, p.lru);
+    return p.node;
+}
+
+/**
+ * Request a page to be loaded, unless it is resident or loading.
+ *
+ * @param page Page index.
+ */
+void LeafPager::Request(unsigned int page) {
+    Page& p = pages[page];
+    if (p.node || p.requested || !loader) return;
+    p.requested = true;
+    loader->Submit(new LoadTask(this, page), loads,
+                   loader->GetExternalWorker());
+}
+
+/**
+ * Make the loaded pages resident and evict the least recently used
+ * pages over the memory budget. Called once per frame, before the
+ * pages are used.
+ */
+void LeafPager::Update() {
+    update++;
+    std::vector<Loaded> done;
+    lock.Lock();
+    done.swap(loaded);
+    lock.Unlock();
+    for (unsigned int i = 0; i < done.size(); i++) {
+        Page& p = pages[done[i].page];
+        p.requested = false;
+        if (!done[i].faces) continue;
+        p.node = new GeometryNode(done[i].faces);
+        p.used = update;
+        p.lru = lru.insert(lru.end(), done[i].page);
+        resident += p.faces * sizeof(Face);
+    }
+    while (resident > budget && !lru.empty() &&
+           pages[lru.front()].used + 1 < update)
+        Evict(lru.front());
+}
+
+/**
+ * Release a resident page.
+ *
+ * @param page Page index.
+ */
+void LeafPager::Evict(unsigned int page) {
+    Page& p = pages[page];
+    lru.erase(p.lru);
+    delete p.node;
+    p.node = NULL;
+    resident -= p.faces * sizeof(Face);
+}
+
+} // NS Scene
+} // NS OpenEngine
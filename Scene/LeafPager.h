@@ -0,0 +1,139 @@
+// Paged on-disk store of tree leaves.
+// -------------------------------------------------------------------
+// Copyright (C) 2007 OpenEngine.dk (See AUTHORS)
+//
+// This program is free software; It is covered by the GNU General
+// Public License version 2 or any later version.
+// See the GNU General Public License for more details (see LICENSE).
+//--------------------------------------------------------------------
+
+#ifndef _OE_LEAF_PAGER_H_
+#define _OE_LEAF_PAGER_H_
+
+#include <Geometry/FaceSet.h>
+#include <Core/Mutex.h>
+#include <Core/WorkStealingPool.h>
+#include <cstdio>
+#include <cstddef>
+#include <string>
+#include <vector>
+#include <list>
+#include <map>
+
+namespace OpenEngine {
+namespace Scene {
+
+class GeometryNode;
+
+using namespace OpenEngine::Geometry;
+
+/**
+ * Paged on-disk store of tree leaves.
+ *
+ * At build time the faces of each leaf are written to a page of the
+ * store and released, so the built tree holds no leaf geometry. At
+ * render time pages are loaded on a loader thread when requested and
+ * handed out as geometry nodes once resident. The resident pages are
+ * kept under a memory budget, evicting the least recently used pages
+ * first. Memory use is then bounded by the budget, also for worlds
+ * larger than the main memory.
+ *
+ * The pages hold the vertices, normals, texture coordinates and
+ * colors of the faces, and the index of their material in the
+ * material table of the pager. The materials themselves are not
+ * written, a store is opened either by the pager that wrote it or
+ * with the table from GetMaterials() of that pager.
+ *
+ * @code
+ * LeafPager pager;
+ * pager.Create("world.pages");
+ * quadt.SetLeafPager(&pager);
+ * quadt.Transform(*scene);
+ * pager.Close();
+ * pager.Open("world.pages");
+ * pager.SetMemoryBudget(256 << 20);
+ * view.SetLeafPager(&pager, 500);
+ * @endcode
+ *
+ * Writing is thread safe, the runtime interface must be used from
+ * one thread. Offsets are 64 bit, so stores may exceed 4 GB.
+ *
+ * Only rendering is out of core. The transformer writing the pages
+ * builds the tree from the complete face set, so the geometry must
+ * fit in memory at build time.
+ *
+ * @see QuadTransformer
+ * @see AcceleratedRenderingView
+ *
+ * @class LeafPager LeafPager.h Scene/LeafPager.h
+ */
+class LeafPager {
+private:
+    class LoadTask;
+
+    //! page of the store
+    struct Page {
+        unsigned long long offset;      //!< file offset of the page
+        unsigned int faces;             //!< faces in the page
+        GeometryNode* node;             //!< resident geometry or NULL
+        bool requested;                 //!< load in progress
+        unsigned int used;              //!< update the page was last used
+        std::list<unsigned int>::iterator lru;
+    };
+
+    //! page loaded by the loader thread
+    struct Loaded {
+        unsigned int page;
+        FaceSet* faces;
+    };
+
+    FILE* file;
+    bool writing;
+    std::vector<Page> pages;
+    std::vector<MaterialPtr> materials;
+    std::map<Material*, unsigned int> materialIds;
+    std::list<unsigned int> lru;        //!< resident pages, least recent first
+    size_t budget;
+    size_t resident;
+    unsigned int update;
+
+    Core::Mutex lock;                   //!< guards the file and loaded
+    std::vector<Loaded> loaded;
+    Core::WorkStealingPool* loader;
+    Core::TaskGroup loads;
+
+    // not copyable
+    LeafPager(const LeafPager&);
+    LeafPager& operator=(const LeafPager&);
+
+    FaceSet* Read(unsigned int page);
+    void Evict(unsigned int page);
+    void Reset();
+
+public:
+    LeafPager();
+    ~LeafPager();
+
+    void Create(const std::string& filename);
+    unsigned int Write(FaceSet& faces);
+    void Close();
+
+    void Open(const std::string& filename);
+    void Open(const std::string& filename,
+              const std::vector<MaterialPtr>& materials);
+    const std::vector<MaterialPtr>& GetMaterials() const;
+    void SetMemoryBudget(size_t bytes);
+    size_t GetMemoryBudget() const;
+    size_t GetResidentSize() const;
+    unsigned int GetPageCount() const;
+
+    FaceSet* Load(unsigned int page);
+    GeometryNode* Get(unsigned int page);
+    void Request(unsigned int page);
+    void Update();
+};
+
+} // NS Scene
+} // NS OpenEngine
+
+#endif // _OE_LEAF_PAGER_H_
@@ -0,0 +1,122 @@
+// Arena for acceleration structure nodes.
+// -------------------------------------------------------------------
+// Copyright (C) 2007 OpenEngine.dk (See AUTHORS) 
+// 
+// This program is free software; It is covered by the GNU General 
+// Public License version 2 or any later version. 
+// See the GNU General Public License for more details (see LICENSE). 
+//--------------------------------------------------------------------
+
+#include <Scene/NodeArena.h>
+
+namespace OpenEngine {
+namespace Scene {
+
+// alignment of all allocations
+static const size_t alignment = 16;
+
+/**
+ * Create an arena.
+ *
+ * @param chunkSize Size in bytes of the chunks allocated from the heap.
+ */
+NodeArena::NodeArena(size_t chunkSize)
+    : chunkSize(chunkSize), bytes(0) {
+
+}
+
+/**
+ * Destructor.
+ * Destroys all objects in the arena.
+ */
+NodeArena::~NodeArena() {
+    Clear();
+    for (unsigned int i = 0; i < chunks.size(); i++)
+        delete[] chunks[i].data;
+}
+
+/**
+ * Allocate memory from the arena.
+ * The memory is aligned for any node type and is valid until the
+ * arena is cleared.
+ *
+ * @param size Size in bytes.
+ * @return Allocated memory.
+ */
+void* NodeArena::Allocate(size_t size) {
+    size = (size + alignment - 1) & ~(alignment - 1);
+    lock.Lock();
+    if (chunks.empty() || chunks.back().used + size > chunks.back().size) {
+        Chunk c;
+        c.size = (size > chunkSize) ? size : chunkSize;
+        c.data = new char[c.size + alignment];
+        c.used = 0;
+        chunks.push_back(c);
+    }
+    Chunk& c = chunks.back();
+    // align the start of the chunk data
+    size_t offset = (alignment - ((size_t)c.data % alignment)) % alignment;
+    void* p = c.data + offset + c.used;
+    c.used += size;
+    bytes += size;
+    lock.Unlock();
+    return p;
+}
+
+void NodeArena::Register(void* object, void (*destroy)(void*)) {
+    Object o;
+    o.object = object;
+    o.destroy = destroy;
+    lock.Lock();
+    objects.push_back(o);
+    lock.Unlock();
+}
+
+/**
+ * Destroy all objects in the arena.
+ * The destructors are run in reverse order of adoption, then all
+ * chunks but the first are released and the first is reused.
+ */
+void NodeArena::Clear() {
+    lock.Lock();
+    while (!objects.empty()) {
+        Object o = objects.back();
+        objects.pop_back();
+        o.destroy(o.object);
+    }
+    for (unsigned int i = 1; i < chunks.size(); i++)
+        delete[] chunks[i].data;
+    if (!chunks.empty()) {
+        chunks.resize(1);
+        chunks[0].used = 0;
+    }
+    bytes = 0;
+    lock.Unlock();
+}
+
+/**
+ * Get the number of bytes allocated from the arena.
+ *
+ * @return Allocated bytes.
+ */
+size_t NodeArena::GetBytesUsed() {
+    lock.Lock();
+    size_t b = bytes;
+    lock.Unlock();
+    return b;
+}
+
+/**
+ * Get the number of objects adopted by the arena.
+ *
+ * @return Object count.
+ */
+size_t NodeArena::GetObjectCount() {
+    lock.Lock();
+    size_t c = objects.size();
+    lock.Unlock();
+    return c;
+}
+
+} // NS Scene
+} // NS OpenEngine
@@ -0,0 +1,114 @@
+// Arena for acceleration structure nodes.
+// -------------------------------------------------------------------
+// Copyright (C) 2007 OpenEngine.dk (See AUTHORS) 
+// 
+// This program is free software; It is covered by the GNU General 
+// Public License version 2 or any later version. 
+// See the GNU General Public License for more details (see LICENSE). 
+//--------------------------------------------------------------------
+
+#ifndef _OE_NODE_ARENA_H_
+#define _OE_NODE_ARENA_H_
+
+#include <Core/Mutex.h>
+#include <cstddef>
+#include <vector>
+
+namespace OpenEngine {
+namespace Scene {
+
+/**
+ * Arena for acceleration structure nodes.
+ *
+ * Nodes are bump allocated from large chunks and the whole tree is
+ * freed in one operation by Clear, which runs the destructors of all
+ * adopted objects and releases the chunks. Nodes in an arena do not
+ * delete their child nodes, as the arena owns them all.
+ *
+ * A tree in an arena is owned by the arena, not by the scene. Remove
+ * the root from the scene before clearing the arena, and never delete
+ * an arena node directly.
+ *
+ * Allocation is guarded by a lock, so parallel builds may share an
+ * arena.
+ *
+ * @code
+ * NodeArena arena;
+ * bspt.SetNodeArena(&arena);
+ * bspt.Transform(*level);
+ * // ... on level change
+ * parent->RemoveNode(root);
+ * arena.Clear();
+ * @endcode
+ *
+ * @class NodeArena NodeArena.h Scene/NodeArena.h
+ */
+class NodeArena {
+private:
+    struct Chunk {
+        char* data;
+        size_t size;
+        size_t used;
+    };
+    struct Object {
+        void* object;
+        void (*destroy)(void*);
+    };
+
+    std::vector<Chunk> chunks;
+    std::vector<Object> objects;
+    size_t chunkSize;
+    size_t bytes;
+    Core::Mutex lock;
+
+    template <class T> static void Destroy(void* object) {
+        static_cast<T*>(object)->~T();
+    }
+    void Register(void* object, void (*destroy)(void*));
+
+public:
+    NodeArena(size_t chunkSize = 1 << 20);
+    virtual ~NodeArena();
+
+    void* Allocate(size_t size);
+    void Clear();
+
+    size_t GetBytesUsed();
+    size_t GetObjectCount();
+
+    /**
+     * Adopt an object created in the arena, so its destructor is run
+     * by Clear.
+     *
+     * @code
+     * QuadNode* node = arena.Adopt(new (arena) QuadNode());
+     * @endcode
+     *
+     * @param object Object placed in memory of this arena.
+     * @return The object.
+     */
+    template <class T> T* Adopt(T* object) {
+        Register(object, &Destroy<T>);
+        return object;
+    }
+};
+
+} // NS Scene
+} // NS OpenEngine
+
+/**
+ * Placement new allocating from a node arena.
+ */
+inline void* operator new(size_t size, OpenEngine::Scene::NodeArena& arena) {
+    return arena.Allocate(size);
+}
+
+/**
+ * Placement delete matching the arena new, used if a constructor
+ * throws. The memory is reclaimed when the arena is cleared.
+ */
+inline void operator delete(void*, OpenEngine::Scene::NodeArena&) {
+
+}
+
+#endif // _OE_NODE_ARENA_H_
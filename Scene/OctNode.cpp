@@ -0,0 +1,221 @@
+// Octree node.
+// -------------------------------------------------------------------
+// Copyright (C) 2007 OpenEngine.dk (See AUTHORS)
+//
+// This program is free software; It is covered by the GNU General
+// Public License version 2 or any later version.
+// See the GNU General Public License for more details (see LICENSE).
+//--------------------------------------------------------------------
+
+#include <Scene/OctNode.h>
+#include <Scene/GeometryNode.h>
+#include <Scene/NodeArena.h>
+#include <Resources/IArchiveWriter.h>
+#include <Resources/IArchiveReader.h>
+
+namespace OpenEngine {
+namespace Scene {
+
+// archive names of the children
+static const char* child_names[8] = {
+    "c0", "c1", "c2", "c3", "c4", "c5", "c6", "c7"
+};
+
+/**
+ * Empty constructor for serialization.
+ */
+OctNode::OctNode()
+    : pooled(false)
+    , hint(0)
+{
+    for (unsigned int i = 0; i < 8; i++) children[i] = NULL;
+}
+
+/**
+ * Create an octree node.
+ *
+ * 1. If an end condition is satisfied terminates the recursive build.
+ *    Else
+ *
+ * 2. Creates dividing planes through the center on the x, y and z
+ *    axis.
+ *
+ * 3. Splits the faces in eight sets, one for each octant.
+ *
+ * 4. Recursively creates the child nodes from the non-empty sets.
+ *
+ * No reference will be kept of the face set supplied and it is the
+ * callers responsibility to delete is if necessary.
+ *
+ * @pre The face set supplied must be non-empty.
+ * @param faces Face set to construct from.
+ * @param count Maximum number of faces that may be in a leaf node.
+ * @param hsize Maximum half size of the bounding box of a leaf node.
+ * @param arena Arena to allocate the sub nodes from, NULL for the heap.
+ *              The node itself must be allocated by the caller.
+ */
+OctNode::OctNode(FaceSet* faces, const int count, const float hsize,
+                 NodeArena* arena)
+    : bb(Box(*faces))
+    , pooled(arena != NULL)
+    , hint(0)
+{
+    for (unsigned int i = 0; i < 8; i++) children[i] = NULL;
+
+    // read out the half sizes on all axes.
+    Vector<3,float> size = bb.GetCorner();
+
+    // if one of the constraints are reached we end the recursive build
+    // and add the faces to a geometry sub node.
+    if (faces->Size() <= count ||
+        (size[0] <= hsize && size[1] <= hsize && size[2] <= hsize)) {
+        AddNode(new GeometryNode(new FaceSet(*faces)));
+        return;
+    }
+
+    // create a divider through the center for each axis, with the
+    // normal pointing to the positive side
+    Vector<3,float> c = bb.GetCenter();
+    FacePtr dividers[3];
+    for (unsigned int axis = 0; axis < 3; axis++) {
+        Vector<3,float> n(0,0,0);
+        n[axis] = 1;
+        // two points in the plane besides the center
+        Vector<3,float> u(0,0,0), v(0,0,0);
+        u[(axis + 1) % 3] = 1;
+        v[(axis + 2) % 3] = 1;
+        dividers[axis] = FacePtr(new Face(c, c + u, c + v, n, n, n));
+    }
+
+    // split on x, then y, then z. like the quad node faces spanning a
+    // divider go to the positive side.
+    FaceSet* sets[8];
+    sets[0] = new FaceSet(*faces);
+    for (unsigned int axis = 0; axis < 3; axis++) {
+        unsigned int bit = 1 << axis;
+        for (unsigned int i = 0; i < bit; i++) {
+            FaceSet* neg = new FaceSet();
+            FaceSet* pos = new FaceSet();
+            sets[i]->Split(dividers[axis], *pos, *pos, *neg);
+            delete sets[i];
+            sets[i] = neg;
+            sets[i | bit] = pos;
+        }
+    }
+
+    // create the sub nodes
+    for (unsigned int i = 0; i < 8; i++) {
+        if (sets[i]->Size() != 0)
+            children[i] = Create(sets[i], count, hsize, arena);
+        delete sets[i];
+    }
+}
+
+/**
+ * Copy constructor.
+ * The copy is always heap allocated, also if \a node is in an arena.
+ *
+ * @param node Node to copy.
+ */
+OctNode::OctNode(const OctNode& node)
+    : ISceneNode(node)
+    , bb(node.bb)
+    , pooled(false)
+    , hint(0)
+{
+    for (unsigned int i = 0; i < 8; i++)
+        children[i] = (node.children[i])
+            ? (OctNode*)node.children[i]->Clone() : NULL;
+}
+
+/**
+ * Octree node destructor.
+ * Deletes the child nodes unless they are owned by a NodeArena.
+ */
+OctNode::~OctNode() {
+    if (pooled) return;
+    for (unsigned int i = 0; i < 8; i++)
+        delete children[i];
+}
+
+/**
+ * Create an octree node on the heap or in an arena.
+ */
+OctNode* OctNode::Create(FaceSet* faces, const int count, const float hsize,
+                         NodeArena* arena) {
+    if (!arena) return new OctNode(faces, count, hsize);
+    return arena->Adopt(new (*arena) OctNode(faces, count, hsize, arena));
+}
+
+/**
+ * Visit sub nodes including the eight children.
+ * The children are visited in index order and thereafter all sub
+ * nodes of the node.
+ *
+ * @param visitor Scene visitor.
+ */
+void OctNode::VisitSubNodes(ISceneNodeVisitor& visitor) {
+    for (unsigned int i = 0; i < 8; i++)
+        if (children[i] != NULL) children[i]->Accept(visitor);
+    list<ISceneNode*>::iterator itr;
+    for (itr = subNodes.begin(); itr != subNodes.end(); itr++)
+        (*itr)->Accept(visitor);
+}
+
+/**
+ * Get a child node.
+ * Bit 0 of the index selects the positive x side, bit 1 the positive
+ * y side and bit 2 the positive z side.
+ *
+ * @param index Child index in [0,8).
+ * @return Child node or NULL.
+ */
+OctNode* OctNode::GetChild(unsigned int index) const {
+    return children[index];
+}
+
+/**
+ * Get the bounding box of this node.
+ *
+ * @return Bounding box.
+ */
+Box OctNode::GetBoundingBox() const {
+    return bb;
+}
+
+/**
+ * Get the frustum plane that culled the node last.
+ *
+ * @return Plane index.
+ * @see CullingPlanes
+ */
+unsigned int OctNode::GetCullingHint() const {
+    return hint;
+}
+
+/**
+ * Set the frustum plane that culled the node last.
+ *
+ * @param hint Plane index.
+ * @see CullingPlanes
+ */
+void OctNode::SetCullingHint(unsigned int hint) {
+    this->hint = hint;
+}
+
+void OctNode::Serialize(Resources::IArchiveWriter& w) {
+    w.WriteObject("bb", &bb);
+    for (unsigned int i = 0; i < 8; i++)
+        w.WriteScene(child_names[i], children[i]);
+}
+
+void OctNode::Deserialize(Resources::IArchiveReader& r) {
+    Box* box = r.ReadObject<Box>("bb");
+    bb = *box;
+    delete box;
+    for (unsigned int i = 0; i < 8; i++)
+        children[i] = dynamic_cast<OctNode*>(r.ReadScene(child_names[i]));
+}
+
+} // NS Scene
+} // NS OpenEngine
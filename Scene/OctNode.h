@@ -0,0 +1,88 @@
+// Octree node.
+// -------------------------------------------------------------------
+// Copyright (C) 2007 OpenEngine.dk (See AUTHORS)
+//
+// This program is free software; It is covered by the GNU General
+// Public License version 2 or any later version.
+// See the GNU General Public License for more details (see LICENSE).
+//--------------------------------------------------------------------
+
+#ifndef _OCT_NODE_H_
+#define _OCT_NODE_H_
+
+#include <Scene/ISceneNode.h>
+#include <Geometry/Box.h>
+#include <Geometry/FaceSet.h>
+
+// forward declarations
+namespace OpenEngine {
+    namespace Resources {
+        class IArchiveWriter;
+        class IArchiveReader;
+    }
+
+namespace Scene {
+
+class ISceneNodeVisitor;
+class NodeArena;
+
+using namespace OpenEngine::Geometry;
+
+/**
+ * Octree node.
+ *
+ * Like a QuadNode, but the node is divided on all three axes, so
+ * scenes with many stories or caves are also partitioned vertically.
+ * The eight children are indexed by the side of the dividers they
+ * lie on, bit 0 set on the positive x side, bit 1 on the positive y
+ * side and bit 2 on the positive z side.
+ * To build a tree please refer to OctTransformer.
+ *
+ * @see OctTransformer
+ * @see QuadNode
+ *
+ * @class OctNode OctNode.h Scene/OctNode.h
+ */
+class OctNode : public ISceneNode {
+    OE_SCENE_NODE(OctNode, ISceneNode)
+
+public:
+    OctNode(); // empty constructor for serialization
+    OctNode(FaceSet* faces, const int count, const float hsize,
+            NodeArena* arena = NULL);
+    OctNode(const OctNode& node);
+    ~OctNode();
+
+    void VisitSubNodes(ISceneNodeVisitor& visitor);
+
+    OctNode* GetChild(unsigned int index) const;
+
+    Box GetBoundingBox() const;
+    unsigned int GetCullingHint() const;
+    void SetCullingHint(unsigned int hint);
+
+    void Serialize(Resources::IArchiveWriter& w);
+    void Deserialize(Resources::IArchiveReader& r);
+
+private:
+
+    //! bounding box
+    Box bb;
+
+    //! sub nodes
+    OctNode* children[8];
+
+    //! node and sub nodes live in a NodeArena
+    bool pooled;
+
+    //! frustum plane that culled the node last
+    unsigned int hint;
+
+    static OctNode* Create(FaceSet* faces, const int count, const float hsize,
+                           NodeArena* arena);
+};
+
+} // NS Scene
+} // NS OpenEngine
+
+#endif // _OCT_NODE_H_
@@ -0,0 +1,94 @@
+// Octree transformer.
+// -------------------------------------------------------------------
+// Copyright (C) 2007 OpenEngine.dk (See AUTHORS)
+//
+// This program is free software; It is covered by the GNU General
+// Public License version 2 or any later version.
+// See the GNU General Public License for more details (see LICENSE).
+//--------------------------------------------------------------------
+
+#include "OctTransformer.h"
+
+namespace OpenEngine {
+namespace Scene {
+
+    /**
+     * Construct an octree transformer, that transforms geometry nodes
+     * to octree nodes.
+     */
+    OctTransformer::OctTransformer()
+        : mCount(500), mHSize(100), mArena(NULL) {
+
+    }
+
+    /**
+     * Destructor.
+     */
+    OctTransformer::~OctTransformer() {
+
+    }
+
+    /**
+     * Transforms the geometry nodes of a tree into octrees.
+     *
+     * @pre The root of the scene to transform may not be of type GeometryNode.
+     * @param node Root node of a scene to build from.
+     */
+    void OctTransformer::Transform(ISceneNode& node) {
+        node.Accept(*this);
+    }
+
+    /**
+     * Set the maximum amount of faces to be contained in a single
+     * octree node.
+     * The default is 500.
+     *
+     * @param count Maximum count.
+     */
+    void OctTransformer::SetMaxFaceCount(const int count) {
+        mCount = count;
+    }
+
+    /**
+     * Maximum size the bounding box of an octree node may be on every
+     * axis.
+     * The default is 200.
+     *
+     * @param size Maximum size of the octree box.
+     */
+    void OctTransformer::SetMaxOctSize(const float size) {
+        mHSize = size / 2;
+    }
+
+    /**
+     * Set the arena to allocate octree nodes from.
+     * The arena is not owned by the transformer.
+     *
+     * @param arena Node arena, NULL to allocate nodes on the heap.
+     * @see NodeArena
+     */
+    void OctTransformer::SetNodeArena(NodeArena* arena) {
+        mArena = arena;
+    }
+
+    /**
+     * Transform the encountered geometry node into an octree node.
+     *
+     * @param node Geometry node.
+     */
+    void OctTransformer::VisitGeometryNode(GeometryNode* node) {
+        FaceSet* faces = node->GetFaceSet();
+        if (faces->Size() != 0) {
+            OctNode* oct;
+            if (mArena)
+                oct = mArena->Adopt(new (*mArena) OctNode(faces, mCount, mHSize, mArena));
+            else
+                oct = new OctNode(faces, mCount, mHSize);
+            node->GetParent()->ReplaceNode(node, oct);
+        } else {
+            node->GetParent()->DeleteNode(node);
+        }
+    }
+
+} // NS Scene
+} // NS OpenEngine
@@ -0,0 +1,67 @@
+// Octree transformer.
+// -------------------------------------------------------------------
+// Copyright (C) 2007 OpenEngine.dk (See AUTHORS)
+//
+// This program is free software; It is covered by the GNU General
+// Public License version 2 or any later version.
+// See the GNU General Public License for more details (see LICENSE).
+//--------------------------------------------------------------------
+
+#ifndef _OCT_TRANSFORMER_H_
+#define _OCT_TRANSFORMER_H_
+
+#include <Scene/OctNode.h>
+#include <Scene/NodeArena.h>
+#include <Scene/GeometryNode.h>
+#include <Scene/ISceneNodeVisitor.h>
+
+namespace OpenEngine {
+namespace Scene {
+
+using OpenEngine::Geometry::FaceSet;
+
+/**
+ * Octree transformer.
+ *
+ * Transforms the geometry nodes of a scene into octrees. Where the
+ * QuadTransformer only divides space on the x and z axis, an octree
+ * also divides it on the y axis. Buildings with many stories and cave
+ * systems are then culled vertically as well.
+ *
+ * @code
+ * OctTransformer octt;
+ * octt.SetMaxFaceCount(500);
+ * octt.SetMaxOctSize(50);
+ * octt.Transform(*scene);
+ * @endcode
+ *
+ * The leaf criteria are those of the QuadTransformer, applied to all
+ * three axes.
+ *
+ * @see QuadTransformer
+ * @see OctNode
+ *
+ * @class OctTransformer OctTransformer.h Scene/OctTransformer.h
+ */
+class OctTransformer : public ISceneNodeVisitor {
+private:
+    int mCount; //!< Max face count in leaf node.
+    float mHSize; //!< Max half size of a leaf node.
+    NodeArena* mArena; //!< Arena to allocate nodes from.
+public:
+    OctTransformer();
+    ~OctTransformer();
+
+    void Transform(ISceneNode& node);
+
+    void SetMaxFaceCount(const int count);
+    void SetMaxOctSize(const float size);
+    void SetNodeArena(NodeArena* arena);
+
+    void VisitGeometryNode(GeometryNode* node);
+};
+
+} // NS Scene
+} // NS OpenEngine
+
+#endif // _OCT_TRANSFORMER_H_
@@ -0,0 +1,193 @@
+// Parallel culling of quad trees.
+// -------------------------------------------------------------------
+// Copyright (C) 2007 OpenEngine.dk (See AUTHORS)
+//
+// This program is free software; It is covered by the GNU General
+// Public License version 2 or any later version.
+// See the GNU General Public License for more details (see LICENSE).
+//--------------------------------------------------------------------
+
+#include <Scene/ParallelQuadCuller.h>
+#include <Scene/QuadNode.h>
+#include <Scene/GeometryNode.h>
+#include <Core/WorkStealingPool.h>
+
+namespace OpenEngine {
+namespace Scene {
+
+/**
+ * Task culling the sub tree of a segment.
+ */
+class ParallelQuadCuller::CullTask : public Core::ITask {
+private:
+    const CullingPlanes* planes;
+    Segment* segment;
+public:
+    CullTask(const CullingPlanes* planes, Segment* segment)
+        : planes(planes), segment(segment) {}
+    void Run(Core::WorkStealingPool& pool, unsigned int worker) {
+        Traverse(*planes, segment->root, segment->mask, segment->nodes);
+    }
+};
+
+/**
+ * Create a culler.
+ *
+ * @param threads Number of culling threads, zero culls on the
+ *                calling thread only.
+ * @param splitDepth Depth at which the traversal is split in tasks.
+ */
+ParallelQuadCuller::ParallelQuadCuller(unsigned int threads,
+                                       unsigned int splitDepth)
+    : pool((threads > 0) ? new Core::WorkStealingPool(threads) : NULL)
+    , splitDepth(splitDepth), used(0) {
+
+}
+
+/**
+ * Destructor, stops the culling threads.
+ */
+ParallelQuadCuller::~ParallelQuadCuller() {
+    delete pool;
+}
+
+/**
+ * Set the depth at which the traversal is split in tasks.
+ * A depth of d gives up to 4^d tasks, enough to balance the load
+ * when it is a few times the thread count. The default is 3.
+ *
+ * @param depth Split depth.
+ */
+void ParallelQuadCuller::SetSplitDepth(unsigned int depth) {
+    splitDepth = depth;
+}
+
+/**
+ * Get the depth at which the traversal is split in tasks.
+ *
+ * @return Split depth.
+ */
+unsigned int ParallelQuadCuller::GetSplitDepth() const {
+    return splitDepth;
+}
+
+/**
+ * Cull a quad tree against a viewing volume.
+ *
+ * @param root Root of the tree, may be NULL.
+ * @param volume Viewing volume, only read on the calling thread.
+ * @param[out] visible Visible geometry nodes in tree order. The vector
+ *                     is cleared first.
+ */
+void ParallelQuadCuller::Cull(QuadNode* root, Display::IViewingVolume& volume,
+                              std::vector<GeometryNode*>& visible) {
+    Cull(root, CullingPlanes(volume), visible);
+}
+
+/**
+ * Cull a quad tree against frustum planes.
+ *
+ * @param root Root of the tree, may be NULL.
+ * @param planes Frustum planes, copied for the tasks.
+ * @param[out] visible Visible geometry nodes in tree order. The vector
+ *                     is cleared first.
+ */
+void ParallelQuadCuller::Cull(QuadNode* root, const CullingPlanes& planes,
+                              std::vector<GeometryNode*>& visible) {
+    visible.clear();
+    if (root == NULL) return;
+    this->planes = planes;
+
+    // split the first levels in segments, then run the sub trees.
+    // the segments are not resized while the tasks run.
+    used = 0;
+    Split(root, CullingPlanes::ALL_PLANES, 0);
+    if (pool) {
+        Core::TaskGroup group;
+        unsigned int worker = pool->GetExternalWorker();
+        for (unsigned int i = 0; i < used; i++)
+            if (segments[i].root)
+                pool->Submit(new CullTask(&this->planes, &segments[i]),
+                             group, worker);
+        pool->Wait(group, worker);
+    } else {
+        for (unsigned int i = 0; i < used; i++)
+            if (segments[i].root)
+                Traverse(this->planes, segments[i].root, segments[i].mask,
+                         segments[i].nodes);
+    }
+
+    // merge in tree order
+    for (unsigned int i = 0; i < used; i++)
+        visible.insert(visible.end(), segments[i].nodes.begin(),
+                       segments[i].nodes.end());
+}
+
+/**
+ * Get the next segment of the frame, reusing the earlier ones.
+ */
+ParallelQuadCuller::Segment& ParallelQuadCuller::NextSegment() {
+    if (used == segments.size()) segments.push_back(Segment());
+    Segment& s = segments[used++];
+    s.root = NULL;
+    s.mask = 0;
+    s.nodes.clear();
+    return s;
+}
+
+/**
+ * Cull the levels above the split depth and create the segments.
+ */
+void ParallelQuadCuller::Split(QuadNode* node, unsigned int mask,
+                               unsigned int depth) {
+    unsigned int hint = node->GetCullingHint();
+    bool visible = planes.Test(node->GetBoundingBox(), mask, hint);
+    node->SetCullingHint(hint);
+    if (!visible) return;
+    if (depth >= splitDepth) {
+        // the root is tested again by the task, with a mask of the
+        // planes it intersects the test is cheap
+        Segment& s = NextSegment();
+        s.root = node;
+        s.mask = mask;
+        return;
+    }
+    QuadNode* children[4] = { node->GetTopLeft(), node->GetTopRight(),
+                              node->GetBottomLeft(), node->GetBottomRight() };
+    for (unsigned int i = 0; i < 4; i++)
+        if (children[i]) Split(children[i], mask, depth + 1);
+    if (!node->subNodes.empty())
+        Collect(node, NextSegment().nodes);
+}
+
+/**
+ * Add the geometry sub nodes of a node.
+ */
+void ParallelQuadCuller::Collect(QuadNode* node,
+                                 std::vector<GeometryNode*>& nodes) {
+    for (list<ISceneNode*>::iterator itr = node->subNodes.begin();
+         itr != node->subNodes.end(); itr++) {
+        GeometryNode* geom = dynamic_cast<GeometryNode*>(*itr);
+        if (geom) nodes.push_back(geom);
+    }
+}
+
+/**
+ * Cull a sub tree, in the order of QuadNode::VisitSubNodes.
+ */
+void ParallelQuadCuller::Traverse(const CullingPlanes& planes, QuadNode* node,
+                                  unsigned int mask,
+                                  std::vector<GeometryNode*>& nodes) {
+    unsigned int hint = node->GetCullingHint();
+    bool visible = planes.Test(node->GetBoundingBox(), mask, hint);
+    node->SetCullingHint(hint);
+    if (!visible) return;
+    QuadNode* children[4] = { node->GetTopLeft(), node->GetTopRight(),
+                              node->GetBottomLeft(), node->GetBottomRight() };
+    for (unsigned int i = 0; i < 4; i++)
+        if (children[i]) Traverse(planes, children[i], mask, nodes);
+    Collect(node, nodes);
+}
+
+} // NS Scene
+} // NS OpenEngine
@@ -0,0 +1,98 @@
+// Parallel culling of quad trees.
+// -------------------------------------------------------------------
+// Copyright (C) 2007 OpenEngine.dk (See AUTHORS)
+//
+// This program is free software; It is covered by the GNU General
+// Public License version 2 or any later version.
+// See the GNU General Public License for more details (see LICENSE).
+//--------------------------------------------------------------------
+
+#ifndef _OE_PARALLEL_QUAD_CULLER_H_
+#define _OE_PARALLEL_QUAD_CULLER_H_
+
+#include <Scene/CullingPlanes.h>
+#include <vector>
+
+namespace OpenEngine {
+    namespace Core {
+        class WorkStealingPool;
+    }
+    namespace Display {
+        class IViewingVolume;
+    }
+namespace Scene {
+
+class QuadNode;
+class GeometryNode;
+
+/**
+ * Parallel culling of quad trees.
+ *
+ * The first levels of the tree are culled on the calling thread,
+ * splitting the traversal into one task per sub tree at the split
+ * depth. The tasks cull their sub trees on a work stealing pool
+ * against a copy of the frustum planes, carrying plane masks like
+ * the AcceleratedRenderingView, and write the visible geometry nodes
+ * into lists of their own. The lists are concatenated in tree order,
+ * so the result is the same as that of a serial traversal and does
+ * not depend on the scheduling. The lists are kept between frames.
+ *
+ * @code
+ * ParallelQuadCuller culler(4);
+ * std::vector<GeometryNode*> visible;
+ * // every frame
+ * culler.Cull(root, *viewingVolume, visible);
+ * @endcode
+ *
+ * Only the geometry sub nodes of the quad nodes are collected, paged
+ * leaves and level of detail proxies are left to the
+ * AcceleratedRenderingView.
+ *
+ * @see CullingPlanes
+ *
+ * @class ParallelQuadCuller ParallelQuadCuller.h Scene/ParallelQuadCuller.h
+ */
+class ParallelQuadCuller {
+private:
+    class CullTask;
+
+    //! part of the result in tree order
+    struct Segment {
+        QuadNode* root;                     //!< sub tree of a task or NULL
+        unsigned int mask;                  //!< planes intersecting the root
+        std::vector<GeometryNode*> nodes;   //!< visible geometry
+    };
+
+    Core::WorkStealingPool* pool;
+    unsigned int splitDepth;
+    CullingPlanes planes;
+    std::vector<Segment> segments;
+    unsigned int used;                      //!< segments of this frame
+
+    // not copyable
+    ParallelQuadCuller(const ParallelQuadCuller&);
+    ParallelQuadCuller& operator=(const ParallelQuadCuller&);
+
+    Segment& NextSegment();
+    void Split(QuadNode* node, unsigned int mask, unsigned int depth);
+    static void Collect(QuadNode* node, std::vector<GeometryNode*>& nodes);
+    static void Traverse(const CullingPlanes& planes, QuadNode* node,
+                         unsigned int mask, std::vector<GeometryNode*>& nodes);
+
+public:
+    ParallelQuadCuller(unsigned int threads, unsigned int splitDepth = 3);
+    ~ParallelQuadCuller();
+
+    void SetSplitDepth(unsigned int depth);
+    unsigned int GetSplitDepth() const;
+
+    void Cull(QuadNode* root, Display::IViewingVolume& volume,
+              std::vector<GeometryNode*>& visible);
+    void Cull(QuadNode* root, const CullingPlanes& planes,
+              std::vector<GeometryNode*>& visible);
+};
+
+} // NS Scene
+} // NS OpenEngine
+
+#endif // _OE_PARALLEL_QUAD_CULLER_H_
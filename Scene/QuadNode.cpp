@@ -9,12 +9,155 @@
 
 #include <Scene/QuadNode.h>
 #include <Scene/GeometryNode.h>
+#include <Scene/NodeArena.h>
+#include <Scene/TreeStatistics.h>
+#include <Scene/LeafPager.h>
+#include <Scene/VertexClustering.h>
+#include <Core/WorkStealingPool.h>
+#include <Core/Mutex.h>
 #include <Resources/IArchiveWriter.h>
 #include <Resources/IArchiveReader.h>
+#include <algorithm>
+#include <vector>
 
 namespace OpenEngine {
 namespace Scene {
 
+// guards the shared timings of parallel builds
+static Core::Mutex timings_lock;
+
+// archive format version written after the original fields,
+// 1 adds the leaf page, 2 the level of detail proxy
+static const int archive_version = 2;
+
+/**
+ * Task building a quad sub tree on a worker of the build pool.
+ * The task owns the face set.
+ */
+class QuadBuildTask : public Core::ITask {
+private:
+    QuadNode* node;
+    FaceSet* faces;
+    QuadBuildOptions options;
+public:
+    QuadBuildTask(QuadNode* node, FaceSet* faces, const QuadBuildOptions& options)
+        : node(node), faces(faces), options(options) {}
+    void Run(Core::WorkStealingPool& pool, unsigned int worker) {
+        BuildTimings local;
+        BuildTimings* shared = options.timings;
+        if (shared) options.timings = &local;
+        options.worker = worker;
+        node->bb = Box(*faces);
+        node->Build(faces, options);
+        delete faces;
+        if (shared) {
+            timings_lock.Lock();
+            shared->Add(local);
+            timings_lock.Unlock();
+        }
+    }
+};
+
+// one chunk of a face set split in four by a parallel split pass
+struct QuadSplitChunk {
+    FaceSet faces;
+    FaceSet sets[4];
+};
+
+/**
+ * Task splitting a chunk of faces by the two quad dividers.
+ */
+class QuadSplitTask : public Core::ITask {
+private:
+    QuadSplitChunk* chunk;
+    FacePtr horiz, verti;
+public:
+    QuadSplitTask(QuadSplitChunk* chunk, FacePtr horiz, FacePtr verti)
+        : chunk(chunk), horiz(horiz), verti(verti) {}
+    void Run(Core::WorkStealingPool& pool, unsigned int worker) {
+        FaceSet ft, fb;
+        chunk->faces.Split(horiz, ft, ft, fb);
+        ft.Split(verti, chunk->sets[0], chunk->sets[0], chunk->sets[1]);
+        fb.Split(verti, chunk->sets[2], chunk->sets[2], chunk->sets[3]);
+    }
+};
+
+// face index with the Morton code of its centroid
+struct MortonItem {
+    unsigned int code;
+    unsigned int face;
+};
+
+// shared state of a linear build
+struct LinearBuild {
+    std::vector<FacePtr> faces;
+    std::vector<MortonItem> items;
+    float extent[2];                 //!< centroid extent on x and z
+    const QuadBuildOptions* options;
+};
+
+// levels of a linear build, 16 bits per axis
+static const unsigned int linear_levels = 16;
+
+// spread the lower 16 bits to the even bits
+static unsigned int SpreadBits(unsigned int x) {
+    x &= 0x0000ffff;
+    x = (x | (x << 8)) & 0x00ff00ff;
+    x = (x | (x << 4)) & 0x0f0f0f0f;
+    x = (x | (x << 2)) & 0x33333333;
+    x = (x | (x << 1)) & 0x55555555;
+    return x;
+}
+
+// quadrant of a Morton code at a level, in top left, top right,
+// bottom left, bottom right order
+static unsigned int Quadrant(unsigned int code, unsigned int level) {
+    return (code >> (2 * (linear_levels - 1 - level))) & 3;
+}
+
+// quantize a coordinate to 16 bits
+static unsigned int Quantize(float x, float min, float scale) {
+    unsigned int q = (unsigned int)((x - min) * scale);
+    return (q < 0xffff) ? q : 0xffff;
+}
+
+// compute the Morton codes of a range of faces
+static void ComputeCodes(LinearBuild* build, unsigned int begin,
+                         unsigned int end, const float min[2],
+                         const float scale[2]) {
+    for (unsigned int i = begin; i < end; i++) {
+        Face& f = *build->faces[i];
+        float x = (f.vert[0][0] + f.vert[1][0] + f.vert[2][0]) / 3;
+        float z = (f.vert[0][2] + f.vert[1][2] + f.vert[2][2]) / 3;
+        // inverted, so the top left quadrant (+x, +z) sorts first
+        unsigned int qx = 0xffff - Quantize(x, min[0], scale[0]);
+        unsigned int qz = 0xffff - Quantize(z, min[1], scale[1]);
+        MortonItem& item = build->items[i];
+        item.code = SpreadBits(qx) | (SpreadBits(qz) << 1);
+        item.face = i;
+    }
+}
+
+/**
+ * Task computing the Morton codes of a range of faces.
+ */
+class MortonCodeTask : public Core::ITask {
+private:
+    LinearBuild* build;
+    unsigned int begin, end;
+    float min[2], scale[2];
+public:
+    MortonCodeTask(LinearBuild* build, unsigned int begin, unsigned int end,
+                   const float min[2], const float scale[2])
+        : build(build), begin(begin), end(end) {
+        this->min[0] = min[0]; this->min[1] = min[1];
+        this->scale[0] = scale[0]; this->scale[1] = scale[1];
+    }
+    void Run(Core::WorkStealingPool& pool, unsigned int worker) {
+        ComputeCodes(build, begin, end, min, scale);
+    }
+};
+
 /**
  * Create a quad tree node.
  *
@@ -36,26 +179,119 @@ namespace Scene {
  * @param faces Face set to construct from.
  * @param count Maximum number of faces that may be in a leaf node.
  * @param hsize Maximum half size of the bounding square of a leaf node.
+ * @param arena Arena to allocate the sub nodes from, NULL for the heap.
+ *              The node itself must be allocated by the caller.
+ * @param timings Timings to add the time of the build phases to, or NULL.
+ */
+QuadNode::QuadNode(FaceSet* faces, const int count, const float hsize,
+                   NodeArena* arena, BuildTimings* timings)
+    : bb(Box(*faces))
+    , tl(NULL)
+    , tr(NULL)
+    , bl(NULL)
+    , br(NULL)
+    , pooled(arena != NULL)
+    , hint(0)
+    , page(-1)
+    , paged(NULL)
+    , proxy(NULL)
+    , error(0)
+{
+    QuadBuildOptions options;
+    options.count = count;
+    options.hsize = hsize;
+    options.arena = arena;
+    options.timings = timings;
+    Build(faces, options);
+}
+
+/**
+ * Create a quad tree node with build options.
+ *
+ * In loose mode no faces are split. Each face is assigned whole to
+ * the child quadrant containing its center, if the quadrant enlarged
+ * by the looseness factor on each side also contains the whole face.
+ * Other faces stay in a geometry sub node of the inner node.
+ *
+ * With a pool in the options, sub trees of at least the cutoff
+ * number of faces are built as tasks on the pool, and face sets of
+ * at least twice the cutoff are split in chunks in parallel. The
+ * constructor returns when the whole tree is built. The resulting
+ * tree is the same as the one of a serial build.
+ *
+ * The linear build works bottom up instead, see BuildLinear.
+ *
+ * @pre The face set supplied must be non-empty.
+ * @param faces Face set to construct from.
+ * @param options Build options. The node itself must be allocated
+ *                by the caller, also if an arena is given.
  */
-QuadNode::QuadNode(FaceSet* faces, const int count, const float hsize)
+QuadNode::QuadNode(FaceSet* faces, const QuadBuildOptions& options)
     : bb(Box(*faces))
     , tl(NULL)
     , tr(NULL)
     , bl(NULL)
     , br(NULL)
+    , pooled(options.arena != NULL)
+    , hint(0)
+    , page(-1)
+    , paged(NULL)
+    , proxy(NULL)
+    , error(0)
 {
+    if (options.linear) {
+        BuildLinear(faces, options);
+        return;
+    }
+    if (!options.pool || options.group) {
+        Build(faces, options);
+        return;
+    }
+
+    // root of a parallel build, the tasks add their timings to the
+    // shared timings under the lock
+    Core::TaskGroup group;
+    BuildTimings local;
+    QuadBuildOptions root = options;
+    root.group = &group;
+    root.worker = options.pool->GetExternalWorker();
+    if (options.timings) root.timings = &local;
+    Build(faces, root);
+    options.pool->Wait(group, root.worker);
+    if (options.timings) {
+        timings_lock.Lock();
+        options.timings->Add(local);
+        timings_lock.Unlock();
+    }
+}
+
+void QuadNode::Build(FaceSet* faces, const QuadBuildOptions& options) {
     // read out the half sizes on the x and z axis.
     float sizeX = bb.GetCorner()[0];
     float sizeZ = bb.GetCorner()[2];
 
     // if one of the constraints are reached we end the recursive build
     // and add the faces to a geometry sub node.
-    if (faces->Size() <= count || (sizeX <= hsize && sizeZ <= hsize)) {
-        AddNode(new GeometryNode(new FaceSet(*faces)));
+    BuildTimings* timings = options.timings;
+    unsigned long long time = (timings) ? BuildTimings::Now() : 0;
+    if (faces->Size() <= options.count ||
+        (sizeX <= options.hsize && sizeZ <= options.hsize)) {
+        AddLeaf(new FaceSet(*faces), options);
+        if (timings) timings->allocation += BuildTimings::Now() - time;
         return;
     }
 
-    // else split and create sub quads
+    if (options.loose) BuildLoose(faces, options);
+    else BuildSplit(faces, options);
+}
+
+void QuadNode::BuildSplit(FaceSet* faces, const QuadBuildOptions& options) {
+    float sizeX = bb.GetCorner()[0];
+    float sizeZ = bb.GetCorner()[2];
+    BuildTimings* timings = options.timings;
+    unsigned long long time = (timings) ? BuildTimings::Now() : 0;
+
+    // split and create sub quads
 
     Vector<2,float> center(bb.GetCenter()[0], bb.GetCenter()[2]);
 
@@ -74,69 +310,411 @@ QuadNode::QuadNode(FaceSet* faces, const int count, const float hsize)
                            Vector<3,float>(1,0,0),
                            Vector<3,float>(1,0,0),
                            Vector<3,float>(1,0,0)));
+    if (timings) {
+        unsigned long long now = BuildTimings::Now();
+        timings->divider += now - time;
+        time = now;
+    }
 
     // create face sets
-    FaceSet ft;
-    FaceSet fb;
     FaceSet* ftl = new FaceSet();
     FaceSet* ftr = new FaceSet();
     FaceSet* fbl = new FaceSet();
     FaceSet* fbr = new FaceSet();
 
-    // split in two sets - top and bottom
-    faces->Split(horiz, ft, ft, fb);
+    if (options.pool && (unsigned int)faces->Size() >= 2 * options.cutoff) {
+        FaceSet* sets[4] = { ftl, ftr, fbl, fbr };
+        SplitParallel(faces, horiz, verti, sets, options);
+    } else {
+        FaceSet ft;
+        FaceSet fb;
 
-    // split in four sets
-    ft.Split(verti, *ftl, *ftl, *ftr);
-    fb.Split(verti, *fbl, *fbl, *fbr);
+        // split in two sets - top and bottom
+        faces->Split(horiz, ft, ft, fb);
+
+        // split in four sets
+        ft.Split(verti, *ftl, *ftl, *ftr);
+        fb.Split(verti, *fbl, *fbl, *fbr);
+    }
+    if (timings) timings->partition += BuildTimings::Now() - time;
 
     // create the sub nodes
-    if (ftl->Size() != 0) tl = new QuadNode(ftl, count, hsize);
-    if (ftr->Size() != 0) tr = new QuadNode(ftr, count, hsize);
-    if (fbl->Size() != 0) bl = new QuadNode(fbl, count, hsize);
-    if (fbr->Size() != 0) br = new QuadNode(fbr, count, hsize);
+    if (ftl->Size() != 0) tl = Spawn(ftl, options);
+    if (ftr->Size() != 0) tr = Spawn(ftr, options);
+    if (fbl->Size() != 0) bl = Spawn(fbl, options);
+    if (fbr->Size() != 0) br = Spawn(fbr, options);
 
-    // clean the temporary face sets
+    // clean the temporary face sets not taken by tasks
     delete ftl;
     delete ftr;
     delete fbl;
     delete fbr;
 }
 
+/**
+ * Split a face set by the quad dividers in chunks on the pool.
+ * The chunks are merged in order, so the sets are the same as those
+ * of a serial split.
+ */
+void QuadNode::SplitParallel(FaceSet* faces, FacePtr horiz, FacePtr verti,
+                             FaceSet* sets[4], const QuadBuildOptions& options) {
+    unsigned int chunks = faces->Size() / ((options.cutoff) ? options.cutoff : 1);
+    unsigned int limit = 4 * options.pool->GetThreadCount();
+    if (chunks > limit) chunks = limit;
+    unsigned int size = (faces->Size() + chunks - 1) / chunks;
+
+    std::vector<QuadSplitChunk*> parts;
+    Core::TaskGroup group;
+    FaceList::iterator itr = faces->begin();
+    while (itr != faces->end()) {
+        QuadSplitChunk* chunk = new QuadSplitChunk();
+        for (unsigned int i = 0; i < size && itr != faces->end(); i++, itr++)
+            chunk->faces.Add(*itr);
+        parts.push_back(chunk);
+        options.pool->Submit(new QuadSplitTask(chunk, horiz, verti),
+                             group, options.worker);
+    }
+    options.pool->Wait(group, options.worker);
+    for (unsigned int i = 0; i < parts.size(); i++) {
+        for (unsigned int j = 0; j < 4; j++)
+            sets[j]->Add(&parts[i]->sets[j]);
+        delete parts[i];
+    }
+}
+
+void QuadNode::BuildLoose(FaceSet* faces, const QuadBuildOptions& options) {
+    BuildTimings* timings = options.timings;
+    unsigned long long time = (timings) ? BuildTimings::Now() : 0;
+    Vector<3,float> center = bb.GetCenter();
+    Vector<3,float> corner = bb.GetCorner();
+
+    // the quadrants are enlarged by the looseness on each side
+    float looseX = options.looseness * corner[0] * 0.5f;
+    float looseZ = options.looseness * corner[2] * 0.5f;
+
+    // sets in order top left, top right, bottom left, bottom right
+    FaceSet* sets[4] = { new FaceSet(), new FaceSet(), new FaceSet(), new FaceSet() };
+    FaceSet* inner = new FaceSet();
+    for (FaceList::iterator itr = faces->begin(); itr != faces->end(); itr++) {
+        Face& f = **itr;
+        float lo[2], hi[2];
+        lo[0] = hi[0] = f.vert[0][0];
+        lo[1] = hi[1] = f.vert[0][2];
+        for (unsigned int v = 1; v < 3; v++) {
+            if (f.vert[v][0] < lo[0]) lo[0] = f.vert[v][0];
+            if (f.vert[v][0] > hi[0]) hi[0] = f.vert[v][0];
+            if (f.vert[v][2] < lo[1]) lo[1] = f.vert[v][2];
+            if (f.vert[v][2] > hi[1]) hi[1] = f.vert[v][2];
+        }
+        // quadrant of the face center, as split by the dividers of
+        // BuildSplit the left quadrants are on the positive x side
+        // and the top quadrants on the positive z side
+        bool left = (lo[0] + hi[0]) * 0.5f >= center[0];
+        bool top = (lo[1] + hi[1]) * 0.5f >= center[2];
+        bool fits =
+            ((left) ? lo[0] >= center[0] - looseX : hi[0] <= center[0] + looseX) &&
+            ((top) ? lo[1] >= center[2] - looseZ : hi[1] <= center[2] + looseZ);
+        if (fits) sets[(top ? 0 : 2) + (left ? 0 : 1)]->Add(*itr);
+        else inner->Add(*itr);
+    }
+    if (timings) timings->partition += BuildTimings::Now() - time;
+
+    // stop if all faces went to the same place, to always terminate
+    for (unsigned int i = 0; i < 4; i++)
+        if (sets[i]->Size() == faces->Size()) {
+            inner->Add(sets[i]);
+            sets[i]->Empty();
+        }
+
+    QuadNode** children[4] = { &tl, &tr, &bl, &br };
+    for (unsigned int i = 0; i < 4; i++) {
+        if (sets[i]->Size() != 0) *children[i] = Spawn(sets[i], options);
+        delete sets[i];
+    }
+    if (inner->Size() == 0) delete inner;
+    else if (!tl && !tr && !bl && !br) AddLeaf(inner, options);
+    else AddNode(new GeometryNode(inner));
+}
+
+/**
+ * Add the faces of a leaf, as a geometry sub node or as a page of the
+ * leaf pager of the options.
+ *
+ * @param faces Leaf faces, owned by the node afterwards.
+ * @param options Build options.
+ */
+void QuadNode::AddLeaf(FaceSet* faces, const QuadBuildOptions& options) {
+    if (!options.pager) {
+        AddNode(new GeometryNode(faces));
+        return;
+    }
+    page = options.pager->Write(*faces);
+    if (options.keep) paged = faces;
+    else delete faces;
+}
+
+/**
+ * Serialize the node.
+ * The original fields come first in their original order, followed
+ * by the format version and the fields added since, so new fields
+ * are only appended behind a version check.
+ */
 void QuadNode::Serialize(Resources::IArchiveWriter& w) {
     w.WriteObject("bb", &bb);
     w.WriteScene("tl",tl);
     w.WriteScene("tr",tr);
     w.WriteScene("bl",bl);
     w.WriteScene("br",br);
+    w.WriteInt("version", archive_version);
+    w.WriteInt("page", page);
+    w.WriteScene("proxy", proxy);
+    w.WriteFloat("error", error);
 }
 
 void QuadNode::Deserialize(Resources::IArchiveReader& r) {
-    bb = *(r.ReadObject<Box>("bb")); //! @TODO We are leaking!
+    Box* box = r.ReadObject<Box>("bb");
+    bb = *box;
+    delete box;
     tl = dynamic_cast<QuadNode*>(r.ReadScene("tl"));
     tr = dynamic_cast<QuadNode*>(r.ReadScene("tr"));
     bl = dynamic_cast<QuadNode*>(r.ReadScene("bl"));
     br = dynamic_cast<QuadNode*>(r.ReadScene("br"));
+    int version = r.ReadInt("version");
+    page = (version >= 1) ? r.ReadInt("page") : -1;
+    if (version >= 2) {
+        proxy = dynamic_cast<GeometryNode*>(r.ReadScene("proxy"));
+        error = r.ReadFloat("error");
+    }
+}
+
+
+/**
+ * Build the tree bottom up from the Morton codes of the face
+ * centroids.
+ *
+ * The centroids are quantized to 16 bits on the x and z axis and
+ * the bits interleaved to a Morton code. Sorting the codes with a
+ * radix sort orders the faces along a Z-order curve, where the faces
+ * of any quadrant at any level form a consecutive range. The tree is
+ * then emitted from the sorted ranges in one pass. Faces are never
+ * split, and the bounding box of a node is that of its faces, so the
+ * boxes of siblings may overlap. Levels where all faces fall in the
+ * same quadrant are skipped. Nodes are allocated in depth first
+ * Z-order, so they are contiguous when allocated from an arena.
+ *
+ * With a pool in the options the codes are computed in parallel.
+ *
+ * @param faces Face set to construct from.
+ * @param options Build options.
+ */
+void QuadNode::BuildLinear(FaceSet* faces, const QuadBuildOptions& options) {
+    BuildTimings* timings = options.timings;
+    unsigned long long time = (timings) ? BuildTimings::Now() : 0;
+
+    LinearBuild build;
+    build.options = &options;
+    build.faces.assign(faces->begin(), faces->end());
+    unsigned int n = build.faces.size();
+    build.items.resize(n);
+
+    // bounds of the centroids
+    float min[2], max[2];
+    for (unsigned int i = 0; i < n; i++) {
+        Face& f = *build.faces[i];
+        float c[2] = { (f.vert[0][0] + f.vert[1][0] + f.vert[2][0]) / 3,
+                       (f.vert[0][2] + f.vert[1][2] + f.vert[2][2]) / 3 };
+        for (unsigned int a = 0; a < 2; a++) {
+            if (i == 0 || c[a] < min[a]) min[a] = c[a];
+            if (i == 0 || c[a] > max[a]) max[a] = c[a];
+        }
+    }
+    float scale[2];
+    for (unsigned int a = 0; a < 2; a++) {
+        build.extent[a] = max[a] - min[a];
+        scale[a] = (build.extent[a] > 0) ? 0xffff / build.extent[a] : 0;
+    }
+
+    // the codes
+    if (options.pool && n >= 2 * options.cutoff && options.cutoff > 0) {
+        Core::TaskGroup group;
+        unsigned int worker = options.pool->GetExternalWorker();
+        if (options.group) worker = options.worker;
+        for (unsigned int b = 0; b < n; b += options.cutoff) {
+            unsigned int e = (b + options.cutoff < n) ? b + options.cutoff : n;
+            options.pool->Submit(new MortonCodeTask(&build, b, e, min, scale),
+                                 group, worker);
+        }
+        options.pool->Wait(group, worker);
+    } else ComputeCodes(&build, 0, n, min, scale);
+
+    // radix sort, 8 bits per pass
+    std::vector<MortonItem> tmp(n);
+    MortonItem* src = &build.items[0];
+    MortonItem* dst = &tmp[0];
+    for (unsigned int shift = 0; shift < 32; shift += 8) {
+        unsigned int offsets[256] = { 0 };
+        for (unsigned int i = 0; i < n; i++)
+            offsets[(src[i].code >> shift) & 0xff]++;
+        unsigned int sum = 0;
+        for (unsigned int d = 0; d < 256; d++) {
+            unsigned int c = offsets[d];
+            offsets[d] = sum;
+            sum += c;
+        }
+        for (unsigned int i = 0; i < n; i++)
+            dst[offsets[(src[i].code >> shift) & 0xff]++] = src[i];
+        std::swap(src, dst);
+    }
+    // an even number of passes leaves the result in the items
+    if (timings) {
+        unsigned long long now = BuildTimings::Now();
+        timings->partition += now - time;
+        time = now;
+    }
+
+    // emit the tree
+    float lo[3], hi[3];
+    EmitLinear(build, 0, n, 0, lo, hi);
+    if (timings) timings->allocation += BuildTimings::Now() - time;
+}
+
+/**
+ * Emit a node of a linear build from a range of sorted faces.
+ *
+ * @param build Linear build.
+ * @param begin First item of the range.
+ * @param end End of the range.
+ * @param level Level of the node.
+ * @param[out] lo Minimum corner of the faces of the node.
+ * @param[out] hi Maximum corner of the faces of the node.
+ */
+void QuadNode::EmitLinear(const LinearBuild& build, unsigned int begin,
+                          unsigned int end, unsigned int level,
+                          float lo[3], float hi[3]) {
+    const QuadBuildOptions& options = *build.options;
+    const std::vector<MortonItem>& items = build.items;
+    bool leaf = false;
+    for (;;) {
+        float scale = 1.0f / (2 << level);
+        if (end - begin <= (unsigned int)options.count ||
+            level >= linear_levels ||
+            (build.extent[0] * scale <= options.hsize &&
+             build.extent[1] * scale <= options.hsize)) {
+            // leaf
+            FaceSet* set = new FaceSet();
+            for (unsigned int i = begin; i < end; i++) {
+                const FacePtr& f = build.faces[items[i].face];
+                set->Add(f);
+                for (unsigned int v = 0; v < 3; v++)
+                    for (unsigned int a = 0; a < 3; a++) {
+                        float x = f->vert[v][a];
+                        if ((i == begin && v == 0) || x < lo[a]) lo[a] = x;
+                        if ((i == begin && v == 0) || x > hi[a]) hi[a] = x;
+                    }
+            }
+            AddLeaf(set, options);
+            leaf = true;
+            break;
+        }
+        if (Quadrant(items[begin].code, level) !=
+            Quadrant(items[end - 1].code, level))
+            break;
+        // all faces in one quadrant, descend without a node
+        level++;
+    }
+
+    if (!leaf) {
+        QuadNode** children[4] = { &tl, &tr, &bl, &br };
+        unsigned int b = begin;
+        bool first = true;
+        while (b < end) {
+            unsigned int q = Quadrant(items[b].code, level);
+            unsigned int e = b + 1;
+            while (e < end && Quadrant(items[e].code, level) == q) e++;
+            QuadNode* child;
+            if (options.arena) {
+                child = options.arena->Adopt(new (*options.arena) QuadNode());
+                child->pooled = true;
+            } else child = new QuadNode();
+            *children[q] = child;
+            float clo[3], chi[3];
+            child->EmitLinear(build, b, e, level + 1, clo, chi);
+            for (unsigned int a = 0; a < 3; a++) {
+                if (first || clo[a] < lo[a]) lo[a] = clo[a];
+                if (first || chi[a] > hi[a]) hi[a] = chi[a];
+            }
+            first = false;
+            b = e;
+        }
+    }
+    bb = Box(Vector<3,float>((lo[0] + hi[0]) / 2, (lo[1] + hi[1]) / 2,
+                             (lo[2] + hi[2]) / 2),
+             Vector<3,float>((hi[0] - lo[0]) / 2, (hi[1] - lo[1]) / 2,
+                             (hi[2] - lo[2]) / 2));
+}
 
+/**
+ * Create a quad node on the heap or in an arena.
+ */
+QuadNode* QuadNode::Create(FaceSet* faces, const QuadBuildOptions& options) {
+    if (!options.arena) return new QuadNode(faces, options);
+    return options.arena->Adopt(new (*options.arena) QuadNode(faces, options));
 }
 
+/**
+ * Create a sub node, as a task on the pool if the face set is large
+ * enough. A task takes over the face set and sets \a faces to NULL.
+ */
+QuadNode* QuadNode::Spawn(FaceSet*& faces, const QuadBuildOptions& options) {
+    if (!options.pool || (unsigned int)faces->Size() < options.cutoff)
+        return Create(faces, options);
+    QuadNode* node;
+    if (!options.arena) node = new QuadNode();
+    else {
+        node = options.arena->Adopt(new (*options.arena) QuadNode());
+        node->pooled = true;
+    }
+    options.pool->Submit(new QuadBuildTask(node, faces, options),
+                         *options.group, options.worker);
+    faces = NULL;
+    return node;
+}
 
 /**
  * Quad node destructor.
+ * Deletes the quad sub nodes unless they are owned by a NodeArena.
  */
 QuadNode::~QuadNode() {
-
+    delete paged;
+    delete proxy;
+    if (pooled) return;
+    delete tl;
+    delete tr;
+    delete bl;
+    delete br;
 }
 
 /**
  * Copy constructor.
+ * The copy is always heap allocated, also if \a node is in an arena.
  *
  * @param node Node to copy.
  */
 QuadNode::QuadNode(const QuadNode& node)
     : ISceneNode(node)
     , bb(node.bb)
+    , tl(NULL)
+    , tr(NULL)
+    , bl(NULL)
+    , br(NULL)
+    , pooled(false)
+    , hint(0)
+    , page(node.page)
+    , paged(NULL)
+    , proxy(NULL)
+    , error(node.error)
 {
+    if (node.proxy) proxy = (GeometryNode*)node.proxy->Clone();
     if (node.tl) tl = (QuadNode*)node.tl->Clone();
     if (node.tr) tr = (QuadNode*)node.tr->Clone();
     if (node.bl) bl = (QuadNode*)node.bl->Clone();
@@ -205,5 +783,119 @@ Box QuadNode::GetBoundingBox() const {
     return bb;
 }
 
+/**
+ * Get the frustum plane that culled the node last.
+ *
+ * @return Plane index.
+ * @see CullingPlanes
+ */
+unsigned int QuadNode::GetCullingHint() const {
+    return hint;
+}
+
+/**
+ * Set the frustum plane that culled the node last.
+ *
+ * @param hint Plane index.
+ * @see CullingPlanes
+ */
+void QuadNode::SetCullingHint(unsigned int hint) {
+    this->hint = hint;
+}
+
+/**
+ * Get the page of the leaf faces, for trees built with a LeafPager.
+ *
+ * @return Page index, -1 if the faces are not paged.
+ * @see LeafPager
+ */
+int QuadNode::GetPage() const {
+    return page;
+}
+
+/**
+ * Get the simplified geometry of the sub tree.
+ * The proxy is not a sub node, so it is not visited with the tree.
+ *
+ * @return Proxy geometry, NULL if none was built.
+ * @see BuildProxies
+ */
+GeometryNode* QuadNode::GetProxy() const {
+    return proxy;
+}
+
+/**
+ * Get the geometric error of the proxy, the largest distance a
+ * vertex of the sub tree has moved in it.
+ *
+ * @return Error in world units.
+ */
+float QuadNode::GetProxyError() const {
+    return error;
+}
+
+/**
+ * Build the level of detail proxies of the sub tree, bottom up.
+ *
+ * The proxy of a node is the vertex clustering of the faces of its
+ * geometry sub nodes and the proxies of its children, so the cost is
+ * linear in the faces of the tree. The error of a proxy is the
+ * clustering error plus the largest error of its input. Nodes where
+ * clustering removes no faces get no proxy. Paged leaves contribute
+ * the faces kept by a build with QuadBuildOptions::keep, which are
+ * released here. Sub trees with paged leaves built without keeping
+ * their faces have no faces in memory and get no proxies.
+ *
+ * @param resolution Cells along the longest axis of a node.
+ * @param[out] faces Faces representing the sub tree, the proxy or
+ *                   the full geometry.
+ * @param[out] error Geometric error of \a faces.
+ * @return True if the faces of all leaves in the sub tree were
+ *         available.
+ */
+bool QuadNode::BuildProxies(unsigned int resolution, FaceSet& faces,
+                            float& error) {
+    delete proxy;
+    proxy = NULL;
+    this->error = 0;
+
+    FaceSet input;
+    float inputError = 0;
+    bool complete = page < 0 || paged;
+    QuadNode* children[4] = { tl, tr, bl, br };
+    for (unsigned int i = 0; i < 4; i++) {
+        if (!children[i]) continue;
+        FaceSet set;
+        float e;
+        complete = children[i]->BuildProxies(resolution, set, e) && complete;
+        input.Add(&set);
+        if (e > inputError) inputError = e;
+    }
+    for (list<ISceneNode*>::iterator itr = subNodes.begin();
+         itr != subNodes.end(); itr++) {
+        GeometryNode* geom = dynamic_cast<GeometryNode*>(*itr);
+        if (geom) input.Add(geom->GetFaceSet());
+    }
+    if (paged) {
+        input.Add(paged);
+        delete paged;
+        paged = NULL;
+    }
+    error = inputError;
+    if (!complete || input.Size() == 0) return complete;
+
+    float e;
+    FaceSet* simple = VertexClustering::Simplify(input, bb, resolution, e);
+    if (simple->Size() < input.Size()) {
+        proxy = new GeometryNode(simple);
+        this->error = error = inputError + e;
+        faces.Add(simple);
+    } else {
+        delete simple;
+        faces.Add(&input);
+    }
+    return true;
+}
+
 } // NS Scene
 } // NS OpenEngine
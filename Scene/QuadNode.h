@@ -16,6 +16,10 @@
 
 // forward declarations
 namespace OpenEngine {
+    namespace Core {
+        class WorkStealingPool;
+        class TaskGroup;
+    }
     namespace Resources {
         class IArchiveWriter;
         class IArchiveReader;
@@ -24,9 +28,42 @@ namespace OpenEngine {
 namespace Scene {
 
 class ISceneNodeVisitor;
+class GeometryNode;
+class NodeArena;
+class LeafPager;
+struct BuildTimings;
+struct LinearBuild;
 
 using namespace OpenEngine::Geometry;
 
+/**
+ * Options of a quad tree build.
+ *
+ * @see QuadNode
+ * @see QuadTransformer
+ */
+struct QuadBuildOptions {
+    int count;              //!< max faces in a leaf node
+    float hsize;            //!< max half size of a leaf node
+    bool loose;             //!< keep faces whole instead of splitting
+    bool linear;            //!< build bottom up from Morton codes
+    float looseness;        //!< enlargement of loose child bounds, [0,1)
+    NodeArena* arena;       //!< arena to allocate sub nodes from or NULL
+    BuildTimings* timings;  //!< timings to add the build phases to or NULL
+    LeafPager* pager;       //!< store to write the leaves to or NULL
+    bool keep;              //!< keep paged leaf faces for BuildProxies
+    Core::WorkStealingPool* pool; //!< pool for parallel builds or NULL
+    unsigned int cutoff;    //!< min faces of a sub tree built as a task
+    Core::TaskGroup* group; //!< group of the build tasks
+    unsigned int worker;    //!< pool worker index of the calling thread
+
+    QuadBuildOptions()
+        : count(500), hsize(100), loose(false), linear(false), looseness(0.5f)
+        , arena(NULL), timings(NULL), pager(NULL), keep(false)
+        , pool(NULL), cutoff(10000)
+        , group(NULL), worker(0) {}
+};
+
 /**
  * Quad tree node.
  * To build a tree please refer to QuadTreeBuilder.
@@ -39,8 +76,10 @@ class QuadNode : public ISceneNode {
     OE_SCENE_NODE(QuadNode, ISceneNode)
 
 public:
-    QuadNode():tl(NULL),tr(NULL),bl(NULL),br(NULL) {}; // empty constructor for serialization
-    QuadNode(FaceSet* faces, const int count, const float hsize);
+    QuadNode():tl(NULL),tr(NULL),bl(NULL),br(NULL),pooled(false),hint(0),page(-1),paged(NULL),proxy(NULL),error(0) {}; // empty constructor for serialization
+    QuadNode(FaceSet* faces, const int count, const float hsize,
+             NodeArena* arena = NULL, BuildTimings* timings = NULL);
+    QuadNode(FaceSet* faces, const QuadBuildOptions& options);
     QuadNode(const QuadNode& node);
     ~QuadNode();
 
@@ -52,6 +91,12 @@ public:
     QuadNode* GetBottomRight() const;
 
     Box GetBoundingBox() const;
+    unsigned int GetCullingHint() const;
+    void SetCullingHint(unsigned int hint);
+    int GetPage() const;
+    GeometryNode* GetProxy() const;
+    float GetProxyError() const;
+    bool BuildProxies(unsigned int resolution, FaceSet& faces, float& error);
 
     void Serialize(Resources::IArchiveWriter& w);
     void Deserialize(Resources::IArchiveReader& r);
@@ -65,6 +110,41 @@ private:
     //! sub nodes
     QuadNode *tl, *tr, *bl, *br;
 
+    //! node and sub nodes live in a NodeArena
+    bool pooled;
+
+    //! frustum plane that culled the node last
+    unsigned int hint;
+
+    //! page of the leaf faces in a LeafPager, -1 if none
+    int page;
+
+    //! faces of a paged leaf kept until the proxies are built or NULL
+    FaceSet* paged;
+
+    //! simplified geometry of the sub tree or NULL
+    GeometryNode* proxy;
+
+    //! geometric error of the proxy
+    float error;
+
+    void Build(FaceSet* faces, const QuadBuildOptions& options);
+    void AddLeaf(FaceSet* faces, const QuadBuildOptions& options);
+    void BuildSplit(FaceSet* faces, const QuadBuildOptions& options);
+    void BuildLoose(FaceSet* faces, const QuadBuildOptions& options);
+    void SplitParallel(FaceSet* faces, FacePtr horiz, FacePtr verti,
+                       FaceSet* sets[4], const QuadBuildOptions& options);
+
+    void BuildLinear(FaceSet* faces, const QuadBuildOptions& options);
+    void EmitLinear(const LinearBuild& build, unsigned int begin,
+                    unsigned int end, unsigned int level,
+                    float lo[3], float hi[3]);
+
+    friend class QuadBuildTask;
+    static QuadNode* Spawn(FaceSet*& faces, const QuadBuildOptions& options);
+
+    static QuadNode* Create(FaceSet* faces, const QuadBuildOptions& options);
+
 
 };
 
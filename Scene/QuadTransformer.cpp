@@ -8,6 +8,7 @@
 //--------------------------------------------------------------------
 
 #include "QuadTransformer.h"
+#include <Core/WorkStealingPool.h>
 
 namespace OpenEngine {
 namespace Scene {
@@ -17,7 +18,8 @@ namespace Scene {
      * quad nodes.
      */
     QuadTransformer::QuadTransformer() 
-        : mCount(500), mHSize(100){
+        : mCount(500), mHSize(100), mArena(NULL), mPager(NULL)
+        , mLoose(false), mLooseness(0.5f), mLinear(false), mProxies(0), mPool(NULL), mCutoff(10000) {
         
     }
 
@@ -25,7 +27,7 @@ namespace Scene {
      * Destructor.
      */
     QuadTransformer::~QuadTransformer(){
-
+        delete mPool;
     }
     
     /**
@@ -35,7 +37,20 @@ namespace Scene {
      * @param node Root node of a scene to build from.
      */
     void QuadTransformer::Transform(ISceneNode& node){
+        mTimings.Clear();
+        unsigned long long start = BuildTimings::Now();
         node.Accept(*this);
+        mTimings.total = BuildTimings::Now() - start;
+    }
+
+    /**
+     * Get the timings of the last transformation, summed over all
+     * quad trees it built.
+     *
+     * @return Build timings.
+     */
+    BuildTimings QuadTransformer::GetBuildTimings() const {
+        return mTimings;
     }
 
     /**
@@ -59,6 +74,105 @@ namespace Scene {
         mHSize = size / 2;
     }
 
+    /**
+     * Set the arena to allocate quad nodes from.
+     * The arena is not owned by the transformer.
+     *
+     * @param arena Node arena, NULL to allocate nodes on the heap.
+     * @see NodeArena
+     */
+    void QuadTransformer::SetNodeArena(NodeArena* arena) {
+        mArena = arena;
+    }
+
+    /**
+     * Set the store to write the faces of the leaves to.
+     * The pager must be open for writing during the transformation
+     * and is not owned by the transformer.
+     *
+     * @param pager Leaf pager, NULL to keep the leaves in memory.
+     * @see LeafPager
+     */
+    void QuadTransformer::SetLeafPager(LeafPager* pager) {
+        mPager = pager;
+    }
+
+    /**
+     * Enable or disable the loose build, which keeps faces whole.
+     * A face is assigned to a child if it lies within the child
+     * quadrant enlarged by the looseness times half the quadrant size
+     * on each side. It is disabled by default.
+     *
+     * @param enable True to build loose quad trees.
+     * @param looseness Enlargement factor in [0,1).
+     */
+    void QuadTransformer::SetLooseBuild(bool enable, float looseness) {
+        mLoose = enable;
+        mLooseness = looseness;
+    }
+
+    /**
+     * Enable or disable the linear build from Morton codes.
+     * Faces are assigned whole to the leaf containing their centroid
+     * and the leaf criteria apply to the quadrant cells. The face
+     * codes are computed on the thread pool of a parallel build. It
+     * is disabled by default and overrides the loose build.
+     *
+     * @param enable True to build quad trees bottom up.
+     */
+    void QuadTransformer::SetLinearBuild(bool enable) {
+        mLinear = enable;
+    }
+
+    /**
+     * Enable or disable the level of detail proxies.
+     * The proxies are built by vertex clustering after the tree, with
+     * a grid of \a resolution cells along the longest axis of each
+     * node. With a leaf pager the faces of the paged leaves are kept
+     * until the proxies are built, so proxies and paging combine. They
+     * are disabled by default.
+     *
+     * @param enable True to build proxies.
+     * @param resolution Clustering cells along the longest node axis.
+     * @see QuadNode::BuildProxies
+     */
+    void QuadTransformer::SetLODProxies(bool enable, unsigned int resolution) {
+        mProxies = (enable) ? resolution : 0;
+    }
+
+    /**
+     * Enable or disable parallel construction.
+     * Sub trees of at least \a cutoff faces are built as tasks on
+     * the pool, and face sets of at least twice the cutoff are split
+     * in chunks concurrently.
+     *
+     * @param threads Number of build threads, zero disables parallel
+     *                construction.
+     * @param cutoff Minimum face count of a sub tree built as a task.
+     */
+    void QuadTransformer::SetParallelBuild(unsigned int threads,
+                                           unsigned int cutoff) {
+        delete mPool;
+        mPool = (threads > 0) ? new Core::WorkStealingPool(threads) : NULL;
+        mCutoff = cutoff;
+    }
+
+    /**
+     * Get the parallel build pool.
+     * @return Build pool, NULL if construction is serial.
+     */
+    Core::WorkStealingPool* QuadTransformer::GetThreadPool() {
+        return mPool;
+    }
+
+    /**
+     * Get the parallel cutoff.
+     * @return Minimum face count of a sub tree built as a task.
+     */
+    unsigned int QuadTransformer::GetParallelCutoff() {
+        return mCutoff;
+    }
+
     /**
      * Transform the encountered geometry node into a quad node.
      *
@@ -67,7 +181,28 @@ namespace Scene {
     void QuadTransformer::VisitGeometryNode(GeometryNode *node){
         FaceSet *faces = node->GetFaceSet();
         if (faces->Size() != 0){
-            QuadNode *quad = new QuadNode(faces, mCount, mHSize);
+            QuadBuildOptions options;
+            options.count = mCount;
+            options.hsize = mHSize;
+            options.loose = mLoose;
+            options.looseness = mLooseness;
+            options.linear = mLinear;
+            options.arena = mArena;
+            options.pager = mPager;
+            options.keep = mProxies > 0;
+            options.timings = &mTimings;
+            options.pool = mPool;
+            options.cutoff = mCutoff;
+            QuadNode *quad;
+            if (mArena)
+                quad = mArena->Adopt(new (*mArena) QuadNode(faces, options));
+            else
+                quad = new QuadNode(faces, options);
+            if (mProxies) {
+                FaceSet set;
+                float error;
+                quad->BuildProxies(mProxies, set, error);
+            }
             node->GetParent()->ReplaceNode(node, quad);
         } else {
             node->GetParent()->DeleteNode(node);
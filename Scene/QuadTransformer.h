@@ -11,10 +11,15 @@
 #define _QUAD_TRANSFORMER_H_
 
 #include <Scene/QuadNode.h>
+#include <Scene/NodeArena.h>
+#include <Scene/TreeStatistics.h>
 #include <Scene/GeometryNode.h>
 #include <Scene/ISceneNodeVisitor.h>
 
 namespace OpenEngine {
+    namespace Core {
+        class WorkStealingPool;
+    }
 namespace Scene {
         
 using OpenEngine::Geometry::FaceSet;
@@ -56,6 +61,53 @@ using OpenEngine::Geometry::FaceSet;
  * CollectedGeometryTransformer in order to transform an entire scene
  * to a single quad tree.
  *
+ * With a NodeArena all quad nodes are allocated from the arena and
+ * the trees are freed together by clearing it.
+ *
+ * In loose mode faces are never split. Each face goes whole to the
+ * child whose bounds, enlarged by the looseness factor, contain it,
+ * or stays at the inner node. The tree then holds exactly the input
+ * faces, at the cost of child bounds overlapping.
+ *
+ * @code
+ * quadt.SetLooseBuild(true, 0.5);
+ * @endcode
+ *
+ * The linear build constructs the tree bottom up from the Morton
+ * codes of the face centroids, which are radix sorted along a Z-order
+ * curve. It runs in a few linear passes and never splits faces, so
+ * it suits very large terrains. With a NodeArena the nodes are laid
+ * out contiguously in Z-order.
+ *
+ * @code
+ * quadt.SetLinearBuild(true);
+ * @endcode
+ *
+ * With a LeafPager the faces of the leaves are written to a paged
+ * store instead of geometry nodes, and loaded on demand when
+ * rendering with an AcceleratedRenderingView.
+ *
+ * @code
+ * quadt.SetLeafPager(&pager);
+ * @endcode
+ *
+ * Level of detail proxies may be built for the nodes, simplified
+ * geometry of their sub trees that an AcceleratedRenderingView draws
+ * instead of the sub tree when it is small on the screen.
+ *
+ * @code
+ * quadt.SetLODProxies(true, 16);
+ * @endcode
+ *
+ * Construction may run in parallel on a work stealing pool. Sub trees
+ * of at least the parallel cutoff number of faces are built as tasks,
+ * and large face sets are split by the dividers in chunks. The trees
+ * are the same as those of a serial build.
+ *
+ * @code
+ * quadt.SetParallelBuild(4, 10000);
+ * @endcode
+ *
  * @see CollectedGeometryTransformer
  * @see GeometryNode
  *
@@ -65,6 +117,15 @@ class QuadTransformer : public ISceneNodeVisitor {
 private:
     int mCount; //!< Max face count in lead node.
     float mHSize; //!< Max half size of a leaf node.
+    NodeArena* mArena; //!< Arena to allocate nodes from.
+    LeafPager* mPager; //!< Store to write the leaves to.
+    bool mLoose; //!< Build without splitting faces.
+    float mLooseness; //!< Enlargement of loose child bounds.
+    bool mLinear; //!< Build bottom up from Morton codes.
+    unsigned int mProxies; //!< Proxy clustering resolution, 0 for none.
+    BuildTimings mTimings; //!< Timings of the last transformation.
+    Core::WorkStealingPool* mPool; //!< Build pool or NULL.
+    unsigned int mCutoff; //!< Min faces of a sub tree built as a task.
 public:
     QuadTransformer();
     ~QuadTransformer();
@@ -73,6 +134,15 @@ public:
 
     void SetMaxFaceCount(const int count);
     void SetMaxQuadSize(const float size);
+    void SetNodeArena(NodeArena* arena);
+    void SetLeafPager(LeafPager* pager);
+    void SetLooseBuild(bool enable, float looseness = 0.5f);
+    void SetLinearBuild(bool enable);
+    void SetLODProxies(bool enable, unsigned int resolution = 16);
+    void SetParallelBuild(unsigned int threads, unsigned int cutoff = 10000);
+    Core::WorkStealingPool* GetThreadPool();
+    unsigned int GetParallelCutoff();
+    BuildTimings GetBuildTimings() const;
 
     void VisitGeometryNode(GeometryNode* node);
 };
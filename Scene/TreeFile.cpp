@@ -0,0 +1,544 @@
+// Binary file of a compiled tree.
+// -------------------------------------------------------------------
+// Copyright (C) 2007 OpenEngine.dk (See AUTHORS)
+//
+// This program is free software; It is covered by the GNU General
+// Public License version 2 or any later version.
+// See the GNU General Public License for more details (see LICENSE).
+//--------------------------------------------------------------------
+
+#include <Scene/TreeFile.h>
+#include <Core/Exceptions.h>
+#include <cstdio>
+#include <cstring>
+
+#ifndef _WIN32
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+namespace OpenEngine {
+namespace Scene {
+
+using OpenEngine::Core::ResourceException;
+
+static const unsigned int byte_order = 0x01020304;
+
+static unsigned int Align(unsigned int offset) {
+    return (offset + 15) & ~15u;
+}
+
+static unsigned int Adler32(const char* data, size_t size) {
+    unsigned int a = 1, b = 0;
+    while (size > 0) {
+        // sums stay below 2^32 for blocks of at most 5552 bytes
+        size_t n = (size < 5552) ? size : 5552;
+        size -= n;
+        while (n--) {
+            a += (unsigned char)*data++;
+            b += a;
+        }
+        a %= 65521;
+        b %= 65521;
+    }
+    return (b << 16) | a;
+}
+
+bool TreeFile::Packer::Key::operator<(const Key& k) const {
+    for (unsigned int i = 0; i < 3 + ATTRIBUTE_SIZE; i++)
+        if (v[i] != k.v[i]) return v[i] < k.v[i];
+    return false;
+}
+
+/**
+ * Add the vertices and the material of a face.
+ * A vertex equal to an earlier one in position and attributes reuses
+ * its index.
+ *
+ * @param face Face to add.
+ */
+void TreeFile::Packer::Add(const Face& face) {
+    for (unsigned int i = 0; i < 3; i++) {
+        Key key;
+        for (unsigned int c = 0; c < 3; c++) key.v[c]     = face.vert[i][c];
+        for (unsigned int c = 0; c < 3; c++) key.v[3 + c] = face.norm[i][c];
+        for (unsigned int c = 0; c < 2; c++) key.v[6 + c] = face.texc[i][c];
+        for (unsigned int c = 0; c < 4; c++) key.v[8 + c] = face.colr[i][c];
+        std::map<Key, unsigned int>::iterator itr = ids.find(key);
+        if (itr == ids.end()) {
+            unsigned int id = vertices.size() / 3;
+            itr = ids.insert(std::make_pair(key, id)).first;
+            vertices.insert(vertices.end(), key.v, key.v + 3);
+            attributes.insert(attributes.end(), key.v + 3,
+                              key.v + 3 + ATTRIBUTE_SIZE);
+        }
+        indices.push_back(itr->second);
+    }
+    unsigned int id = NO_MATERIAL;
+    if (face.mat) {
+        std::map<Material*, unsigned int>::iterator m =
+            materialIds.find(face.mat.get());
+        if (m == materialIds.end()) {
+            m = materialIds.insert(std::make_pair(face.mat.get(),
+                                   (unsigned int)materialTable.size())).first;
+            materialTable.push_back(face.mat);
+        }
+        id = m->second;
+    }
+    materials.push_back(id);
+}
+
+/**
+ * Remove all vertices, faces and materials.
+ */
+void TreeFile::Packer::Clear() {
+    ids.clear();
+    materialIds.clear();
+    vertices.clear();
+    attributes.clear();
+    indices.clear();
+    materials.clear();
+    materialTable.clear();
+}
+
+/**
+ * Open a tree file.
+ *
+ * @param filename File to open.
+ * @param type Expected tree type.
+ * @param nodeSize Expected node size in bytes.
+ * @param verify Check the checksum, which reads the whole file.
+ * @throws ResourceException if the file cannot be read or does not
+ *         hold a tree of the expected type and version.
+ */
+TreeFile::TreeFile(const std::string& filename, Type type,
+                   unsigned int nodeSize, bool verify)
+    : data(NULL), size(0), mapped(false) {
+#ifndef _WIN32
+    int fd = open(filename.c_str(), O_RDONLY);
+    if (fd < 0)
+        throw ResourceException("Could not open tree file: " + filename);
+    struct stat st;
+    if (fstat(fd, &st) == 0 && st.st_size >= (off_t)sizeof(Header)) {
+        size = st.st_size;
+        void* p = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (p != MAP_FAILED) {
+            data = (char*)p;
+            mapped = true;
+        }
+    }
+    close(fd);
+#endif
+    if (!mapped) {
+        // read the file into one buffer instead
+        FILE* file = fopen(filename.c_str(), "rb");
+        if (!file)
+            throw ResourceException("Could not open tree file: " + filename);
+        fseek(file, 0, SEEK_END);
+        long length = ftell(file);
+        fseek(file, 0, SEEK_SET);
+        if (length >= (long)sizeof(Header)) {
+            size = length;
+            data = new char[size];
+            if (fread(data, 1, size, file) != size) {
+                delete[] data;
+                data = NULL;
+            }
+        }
+        fclose(file);
+        if (!data)
+            throw ResourceException("Could not read tree file: " + filename);
+    }
+
+    const Header& h = GetHeader();
+    std::string error;
+    if (std::memcmp(h.magic, "OEAS", 4) != 0)
+        error = "Not a tree file: ";
+    else if (h.byteOrder != byte_order)
+        error = "Tree file of another byte order: ";
+    else if (h.version != VERSION)
+        error = "Unsupported tree file version: ";
+    else if (h.type != (unsigned int)type || h.nodeSize != nodeSize)
+        error = "Tree file of another tree type: ";
+    else if (h.size != size ||
+             h.nodeOffset + (size_t)h.nodeCount * nodeSize > size ||
+             h.vertexOffset + (size_t)h.vertexCount * 3 * sizeof(float) > size ||
+             h.attributeOffset + (size_t)h.vertexCount * ATTRIBUTE_SIZE * sizeof(float) > size ||
+             h.indexOffset + (size_t)h.indexCount * sizeof(unsigned int) > size ||
+             h.materialOffset + (size_t)(h.indexCount / 3) * sizeof(unsigned int) > size)
+        error = "Truncated tree file: ";
+    else if (verify && h.checksum != Adler32(data + sizeof(Header), size - sizeof(Header)))
+        error = "Tree file checksum mismatch: ";
+    if (!error.empty()) {
+        Release();
+        throw ResourceException(error + filename);
+    }
+}
+
+/**
+ * Unmap or release the file.
+ */
+TreeFile::~TreeFile() {
+    Release();
+}
+
+void TreeFile::Release() {
+#ifndef _WIN32
+    if (mapped) munmap(data, size);
+    else
+#endif
+    delete[] data;
+    data = NULL;
+    mapped = false;
+}
+
+/**
+ * Get the file header.
+ *
+ * @return Header.
+ */
+const TreeFile::Header& TreeFile::GetHeader() const {
+    return *(const Header*)data;
+}
+
+/**
+ * Get the node array.
+ *
+ * @return Pointer to the first node.
+ */
+const void* TreeFile::GetNodes() const {
+    return data + GetHeader().nodeOffset;
+}
+
+/**
+ * Get the vertex block, three floats per vertex.
+ *
+ * @return Pointer to the first vertex.
+ */
+const float* TreeFile::GetVertices() const {
+    return (const float*)(data + GetHeader().vertexOffset);
+}
+
+/**
+ * Get the attribute block, ATTRIBUTE_SIZE floats per vertex.
+ *
+ * @return Pointer to the attributes of the first vertex.
+ */
+const float* TreeFile::GetAttributes() const {
+    return (const float*)(data + GetHeader().attributeOffset);
+}
+
+/**
+ * Get the index block, three vertex indices per face.
+ *
+ * @return Pointer to the first index.
+ */
+const unsigned int* TreeFile::GetIndices() const {
+    return (const unsigned int*)(data + GetHeader().indexOffset);
+}
+
+/**
+ * Get the material block, one material table index per face.
+ *
+ * @return Pointer to the material index of the first face.
+ */
+const unsigned int* TreeFile::GetMaterials() const {
+    return (const unsigned int*)(data + GetHeader().materialOffset);
+}
+
+/**
+ * Write a tree file.
+ *
+ * @param filename File to write.
+ * @param type Tree type.
+ * @param nodeSize Bytes per node.
+ * @param nodes Node array.
+ * @param nodeCount Number of nodes.
+ * @param geometry Geometry blocks.
+ * @throws ResourceException if the file cannot be written.
+ */
+void TreeFile::Write(const std::string& filename, Type type,
+                     unsigned int nodeSize, const void* nodes,
+                     unsigned int nodeCount, const Geometry& geometry) {
+    Header h;
+    std::memset(&h, 0, sizeof(Header));
+    std::memcpy(h.magic, "OEAS", 4);
+    h.byteOrder = byte_order;
+    h.version = VERSION;
+    h.type = type;
+    h.nodeSize = nodeSize;
+    h.nodeCount = nodeCount;
+    h.vertexCount = geometry.vertexCount;
+    h.indexCount = geometry.faceCount * 3;
+    h.materialCount = geometry.materialCount;
+    h.nodeOffset = Align(sizeof(Header));
+    h.vertexOffset = Align(h.nodeOffset + nodeCount * nodeSize);
+    h.attributeOffset = Align(h.vertexOffset + h.vertexCount * 3 * sizeof(float));
+    h.indexOffset = Align(h.attributeOffset
+                          + h.vertexCount * ATTRIBUTE_SIZE * sizeof(float));
+    h.materialOffset = Align(h.indexOffset + h.indexCount * sizeof(unsigned int));
+    h.size = h.materialOffset + geometry.faceCount * sizeof(unsigned int);
+
+    std::vector<char> buffer(h.size, 0);
+    if (nodeCount)
+        std::memcpy(&buffer[h.nodeOffset], nodes, nodeCount * nodeSize);
+    if (h.vertexCount) {
+        std::memcpy(&buffer[h.vertexOffset], geometry.vertices,
+                    h.vertexCount * 3 * sizeof(float));
+        std::memcpy(&buffer[h.attributeOffset], geometry.attributes,
+                    h.vertexCount * ATTRIBUTE_SIZE * sizeof(float));
+    }
+    if (h.indexCount) {
+        std::memcpy(&buffer[h.indexOffset], geometry.indices,
+                    h.indexCount * sizeof(unsigned int));
+        std::memcpy(&buffer[h.materialOffset], geometry.materials,
+                    geometry.faceCount * sizeof(unsigned int));
+    }
+    h.checksum = Adler32(&buffer[sizeof(Header)], h.size - sizeof(Header));
+    std::memcpy(&buffer[0], &h, sizeof(Header));
+
+    FILE* file = fopen(filename.c_str(), "wb");
+    if (!file)
+        throw ResourceException("Could not create tree file: " + filename);
+    bool ok = fwrite(&buffer[0], 1, buffer.size(), file) == buffer.size();
+    ok = (fclose(file) == 0) && ok;
+    if (!ok)
+        throw ResourceException("Could not write tree file: " + filename);
+}
+
+/**
+ * Create empty geometry blocks.
+ */
+TreeGeometry::TreeGeometry()
+    : file(NULL), vertices(NULL), attributes(NULL), vertexCount(0)
+    , indices(NULL), faceMaterials(NULL), faceCount(0), materialCount(0) {
+
+}
+
+/**
+ * Destructor, releases a loaded file.
+ */
+TreeGeometry::~TreeGeometry() {
+    delete file;
+}
+
+/**
+ * Add a face to the packed face array of a tree being compiled.
+ * The face is shared, not copied.
+ *
+ * @param face Face to add.
+ */
+void TreeGeometry::AddFace(const FacePtr& face) {
+    faces.push_back(face);
+    packer.Add(*face);
+}
+
+/**
+ * Finish the blocks of the faces added since the last clear.
+ */
+void TreeGeometry::Pack() {
+    vertexStore.swap(packer.vertices);
+    attributeStore.swap(packer.attributes);
+    indexStore.swap(packer.indices);
+    materialStore.swap(packer.materials);
+    materials.swap(packer.materialTable);
+    packer.Clear();
+
+    vertexCount = vertexStore.size() / 3;
+    vertices = (vertexCount) ? &vertexStore[0] : NULL;
+    attributes = (vertexCount) ? &attributeStore[0] : NULL;
+    faceCount = faces.size();
+    indices = (faceCount) ? &indexStore[0] : NULL;
+    faceMaterials = (faceCount) ? &materialStore[0] : NULL;
+    materialCount = materials.size();
+}
+
+/**
+ * Remove all faces and materials, and release a loaded file.
+ */
+void TreeGeometry::ClearGeometry() {
+    packer.Clear();
+    vertexStore.clear();
+    attributeStore.clear();
+    indexStore.clear();
+    materialStore.clear();
+    faces.clear();
+    materials.clear();
+    delete file;
+    file = NULL;
+    vertices = NULL;
+    attributes = NULL;
+    indices = NULL;
+    faceMaterials = NULL;
+    vertexCount = faceCount = materialCount = 0;
+}
+
+/**
+ * Write the blocks to a tree file along with a node array.
+ * The materials are saved as indices into the material table.
+ *
+ * @param filename File to write.
+ * @param type Tree type.
+ * @param nodeSize Bytes per node.
+ * @param nodes Node array.
+ * @param nodeCount Number of nodes.
+ * @throws ResourceException if the file cannot be written.
+ */
+void TreeGeometry::SaveFile(const std::string& filename, TreeFile::Type type,
+                            unsigned int nodeSize, const void* nodes,
+                            unsigned int nodeCount) const {
+    TreeFile::Geometry geometry = { vertices, attributes, vertexCount,
+                                    indices, faceMaterials, faceCount,
+                                    materialCount };
+    TreeFile::Write(filename, type, nodeSize, nodes, nodeCount, geometry);
+}
+
+/**
+ * Open a tree file and use its blocks in place, replacing the current
+ * contents. The file is kept until the blocks are cleared or deleted.
+ * There are no materials until they are set with SetMaterials().
+ *
+ * @param filename File to read.
+ * @param type Expected tree type.
+ * @param nodeSize Expected node size in bytes.
+ * @param verify Check the checksum of the file.
+ * @param[out] nodeCount Number of nodes in the file.
+ * @return Node array of the file.
+ * @throws ResourceException if the file does not hold a tree of the
+ *         expected type.
+ */
+const void* TreeGeometry::LoadFile(const std::string& filename,
+                                   TreeFile::Type type, unsigned int nodeSize,
+                                   bool verify, unsigned int& nodeCount) {
+    ClearGeometry();
+    file = new TreeFile(filename, type, nodeSize, verify);
+    const TreeFile::Header& h = file->GetHeader();
+    vertices = file->GetVertices();
+    attributes = file->GetAttributes();
+    vertexCount = h.vertexCount;
+    indices = file->GetIndices();
+    faceMaterials = file->GetMaterials();
+    faceCount = h.indexCount / 3;
+    materialCount = h.materialCount;
+    nodeCount = h.nodeCount;
+    return file->GetNodes();
+}
+
+/**
+ * Get the number of faces in the packed face array.
+ *
+ * @return Face count.
+ */
+unsigned int TreeGeometry::GetFaceCount() const {
+    return faceCount;
+}
+
+/**
+ * Get a face of the packed face array.
+ *
+ * @pre The tree was compiled, not loaded.
+ * @param index Face index.
+ * @return Face.
+ * @see HasFaces
+ */
+const FacePtr& TreeGeometry::GetFace(unsigned int index) const {
+    return faces[index];
+}
+
+/**
+ * Check if the Face objects are available. They are kept for compiled
+ * trees, loaded trees only have the geometry blocks.
+ *
+ * @return True if GetFace may be used.
+ */
+bool TreeGeometry::HasFaces() const {
+    return faceCount > 0 && faces.size() == faceCount;
+}
+
+/**
+ * Get the number of vertices in the vertex block.
+ *
+ * @return Vertex count.
+ */
+unsigned int TreeGeometry::GetVertexCount() const {
+    return vertexCount;
+}
+
+/**
+ * Get the vertex block, three floats per vertex.
+ *
+ * @return Vertices, NULL if the tree is empty.
+ */
+const float* TreeGeometry::GetVertices() const {
+    return vertices;
+}
+
+/**
+ * Get the attribute block, TreeFile::ATTRIBUTE_SIZE floats per vertex:
+ * the normal, the texture coordinates and the color.
+ *
+ * @return Attributes, NULL if the tree is empty.
+ */
+const float* TreeGeometry::GetAttributes() const {
+    return attributes;
+}
+
+/**
+ * Get the index block, three vertex indices per face in the order of
+ * the packed face array.
+ *
+ * @return Indices, NULL if the tree is empty.
+ */
+const unsigned int* TreeGeometry::GetIndices() const {
+    return indices;
+}
+
+/**
+ * Get the material block, the material table index of each face in
+ * the order of the packed face array, TreeFile::NO_MATERIAL for faces
+ * without a material.
+ *
+ * @return Material indices, NULL if the tree is empty.
+ */
+const unsigned int* TreeGeometry::GetMaterialIndices() const {
+    return faceMaterials;
+}
+
+/**
+ * Get the material table.
+ * A compiled tree holds the materials of its faces. A loaded tree
+ * holds the materials set with SetMaterials().
+ *
+ * @return Materials in index order.
+ */
+const std::vector<MaterialPtr>& TreeGeometry::GetMaterials() const {
+    return materials;
+}
+
+/**
+ * Set the material table, typically on a loaded tree with the table
+ * of the tree that was saved.
+ *
+ * @param materials Materials in index order.
+ */
+void TreeGeometry::SetMaterials(const std::vector<MaterialPtr>& materials) {
+    this->materials = materials;
+}
+
+/**
+ * Get the material of a face of the packed face array.
+ *
+ * @param face Face index.
+ * @return Material, NULL if the face has none or its index is not in
+ *         the material table.
+ */
+MaterialPtr TreeGeometry::GetMaterial(unsigned int face) const {
+    unsigned int id = faceMaterials[face];
+    if (id >= materials.size()) return MaterialPtr();
+    return materials[id];
+}
+
+} // NS Scene
+} // NS OpenEngine
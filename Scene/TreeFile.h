@@ -0,0 +1,220 @@
+// Binary file of a compiled tree.
+// -------------------------------------------------------------------
+// Copyright (C) 2007 OpenEngine.dk (See AUTHORS)
+//
+// This program is free software; It is covered by the GNU General
+// Public License version 2 or any later version.
+// See the GNU General Public License for more details (see LICENSE).
+//--------------------------------------------------------------------
+
+#ifndef _OE_TREE_FILE_H_
+#define _OE_TREE_FILE_H_
+
+#include <Geometry/Face.h>
+#include <cstddef>
+#include <string>
+#include <vector>
+#include <map>
+
+namespace OpenEngine {
+namespace Scene {
+
+using namespace OpenEngine::Geometry;
+
+/**
+ * Binary file of a compiled tree.
+ *
+ * The file is a header followed by five blocks: the node array, a
+ * vertex block of three floats per vertex, an attribute block of the
+ * normal, texture coordinates and color of each vertex, an index
+ * block of three vertex indices per face and a material block of one
+ * material index per face. The blocks are 16 byte aligned and
+ * stored in native byte order, so the file is used in place after
+ * it has been opened. On POSIX systems the file is memory mapped,
+ * elsewhere it is read into one buffer. Either way opening the file
+ * costs no allocation per node or face.
+ *
+ * Materials are not stored, only their index in the material table
+ * of the compiled tree, so a loaded tree is given the table of the
+ * tree that was saved.
+ *
+ * The header holds a version and an Adler-32 checksum of the blocks.
+ * Opening a file of another version, byte order, tree type or node
+ * size throws a ResourceException.
+ *
+ * @see CompiledBSP
+ * @see CompiledQuadTree
+ *
+ * @class TreeFile TreeFile.h Scene/TreeFile.h
+ */
+class TreeFile {
+public:
+    //! Tree types stored in files.
+    enum Type {
+        BSP_TREE  = 1,
+        QUAD_TREE = 2
+    };
+
+    static const unsigned int VERSION = 2;
+
+    //! Floats per vertex in the attribute block: normal, texture
+    //! coordinates and color.
+    static const unsigned int ATTRIBUTE_SIZE = 3 + 2 + 4;
+
+    //! Material index of faces without a material.
+    static const unsigned int NO_MATERIAL = 0xffffffff;
+
+    /**
+     * File header, 64 bytes.
+     */
+    struct Header {
+        char magic[4];              //!< "OEAS"
+        unsigned int byteOrder;     //!< 0x01020304 in the writer order
+        unsigned int version;       //!< format version
+        unsigned int type;          //!< tree type
+        unsigned int nodeSize;      //!< bytes per node
+        unsigned int nodeCount;     //!< number of nodes
+        unsigned int vertexCount;   //!< number of vertices
+        unsigned int indexCount;    //!< number of indices
+        unsigned int nodeOffset;    //!< file offset of the node array
+        unsigned int vertexOffset;  //!< file offset of the vertex block
+        unsigned int indexOffset;   //!< file offset of the index block
+        unsigned int size;          //!< file size
+        unsigned int checksum;      //!< Adler-32 of the bytes after the header
+        unsigned int attributeOffset; //!< file offset of the attribute block
+        unsigned int materialOffset;  //!< file offset of the material block
+        unsigned int materialCount;   //!< size of the material table
+    };
+
+    /**
+     * Geometry blocks of a tree, as written to a file.
+     */
+    struct Geometry {
+        const float* vertices;          //!< three floats per vertex
+        const float* attributes;        //!< ATTRIBUTE_SIZE floats per vertex
+        unsigned int vertexCount;       //!< number of vertices
+        const unsigned int* indices;    //!< three vertex indices per face
+        const unsigned int* materials;  //!< material index per face
+        unsigned int faceCount;         //!< number of faces
+        unsigned int materialCount;     //!< size of the material table
+    };
+
+    /**
+     * Packs faces into the geometry blocks, sharing vertices equal in
+     * position and attributes, and builds the material table.
+     */
+    class Packer {
+    private:
+        struct Key {
+            float v[3 + ATTRIBUTE_SIZE];
+            bool operator<(const Key& k) const;
+        };
+        std::map<Key, unsigned int> ids;
+        std::map<Material*, unsigned int> materialIds;
+    public:
+        std::vector<float> vertices;
+        std::vector<float> attributes;
+        std::vector<unsigned int> indices;
+        std::vector<unsigned int> materials;
+        std::vector<MaterialPtr> materialTable;
+        void Add(const Face& face);
+        void Clear();
+    };
+
+private:
+    char* data;
+    size_t size;
+    bool mapped;
+
+    // not copyable
+    TreeFile(const TreeFile&);
+    TreeFile& operator=(const TreeFile&);
+    void Release();
+
+public:
+    TreeFile(const std::string& filename, Type type, unsigned int nodeSize,
+             bool verify = true);
+    ~TreeFile();
+
+    const Header& GetHeader() const;
+    const void* GetNodes() const;
+    const float* GetVertices() const;
+    const float* GetAttributes() const;
+    const unsigned int* GetIndices() const;
+    const unsigned int* GetMaterials() const;
+
+    static void Write(const std::string& filename, Type type,
+                      unsigned int nodeSize, const void* nodes,
+                      unsigned int nodeCount, const Geometry& geometry);
+};
+
+/**
+ * Geometry blocks of a compiled tree.
+ *
+ * Holds the packed face array of a compiled tree as vertex,
+ * attribute, index and material blocks, with the material table.
+ * The blocks are packed in memory when a tree is compiled and used in
+ * place in the TreeFile when it is loaded. CompiledBSP and
+ * CompiledQuadTree add their node arrays on top.
+ *
+ * @see TreeFile
+ *
+ * @class TreeGeometry TreeFile.h Scene/TreeFile.h
+ */
+class TreeGeometry {
+private:
+    // storage of compiled trees, loaded trees use the file
+    TreeFile::Packer packer;
+    std::vector<float> vertexStore;
+    std::vector<float> attributeStore;
+    std::vector<unsigned int> indexStore;
+    std::vector<unsigned int> materialStore;
+    std::vector<FacePtr> faces;
+    TreeFile* file;
+    std::vector<MaterialPtr> materials;
+
+    // not copyable
+    TreeGeometry(const TreeGeometry&);
+    TreeGeometry& operator=(const TreeGeometry&);
+
+protected:
+    // the blocks in use
+    const float* vertices;       //!< three floats per vertex
+    const float* attributes;     //!< TreeFile::ATTRIBUTE_SIZE floats per vertex
+    unsigned int vertexCount;
+    const unsigned int* indices; //!< three vertex indices per face
+    const unsigned int* faceMaterials; //!< material table index per face
+    unsigned int faceCount;
+    unsigned int materialCount;  //!< table size the faces refer to
+
+    TreeGeometry();
+    virtual ~TreeGeometry();
+
+    void AddFace(const FacePtr& face);
+    void Pack();
+    void ClearGeometry();
+    void SaveFile(const std::string& filename, TreeFile::Type type,
+                  unsigned int nodeSize, const void* nodes,
+                  unsigned int nodeCount) const;
+    const void* LoadFile(const std::string& filename, TreeFile::Type type,
+                         unsigned int nodeSize, bool verify,
+                         unsigned int& nodeCount);
+
+public:
+    unsigned int GetFaceCount() const;
+    const FacePtr& GetFace(unsigned int index) const;
+    bool HasFaces() const;
+    unsigned int GetVertexCount() const;
+    const float* GetVertices() const;
+    const float* GetAttributes() const;
+    const unsigned int* GetIndices() const;
+    const unsigned int* GetMaterialIndices() const;
+    const std::vector<MaterialPtr>& GetMaterials() const;
+    void SetMaterials(const std::vector<MaterialPtr>& materials);
+    MaterialPtr GetMaterial(unsigned int face) const;
+};
+
+} // NS Scene
+} // NS OpenEngine
+
+#endif // _OE_TREE_FILE_H_
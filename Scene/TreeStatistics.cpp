@@ -0,0 +1,223 @@
+// Acceleration structure statistics.
+// -------------------------------------------------------------------
+// Copyright (C) 2007 OpenEngine.dk (See AUTHORS)
+//
+// This program is free software; It is covered by the GNU General
+// Public License version 2 or any later version.
+// See the GNU General Public License for more details (see LICENSE).
+//--------------------------------------------------------------------
+
+#include <Scene/TreeStatistics.h>
+#include <Scene/BSPNode.h>
+#include <Scene/QuadNode.h>
+#include <Scene/GeometryNode.h>
+#include <Geometry/FaceSet.h>
+#include <Utils/Timer.h>
+#include <sstream>
+#include <utility>
+
+namespace OpenEngine {
+namespace Scene {
+
+using std::pair;
+using std::make_pair;
+
+/**
+ * Get the current time for build timings.
+ *
+ * @return Time in microseconds.
+ */
+unsigned long long BuildTimings::Now() {
+    return Utils::Timer::GetTime().AsInt();
+}
+
+static float Relation(unsigned int a, unsigned int b) {
+    if (a == 0 || b == 0) return 0;
+    return (a < b) ? (float)a / b : (float)b / a;
+}
+
+// bytes of a face reference in a face set list
+static const size_t face_entry = sizeof(FacePtr) + 2 * sizeof(void*);
+
+TreeStatistics::TreeStatistics() {
+    Clear();
+}
+
+/**
+ * Reset all statistics, including the timings.
+ */
+void TreeStatistics::Clear() {
+    nodes = leaves = minDepth = maxDepth = 0;
+    depths.clear();
+    faces = splitFaces = minLeafFaces = maxLeafFaces = 0;
+    leafFaces = balance = 0;
+    memory = 0;
+    timings.Clear();
+}
+
+void TreeStatistics::AddLeaf(unsigned int depth, unsigned int count) {
+    if (leaves == 0 || depth < minDepth) minDepth = depth;
+    if (leaves == 0 || depth > maxDepth) maxDepth = depth;
+    if (leaves == 0 || count < minLeafFaces) minLeafFaces = count;
+    if (leaves == 0 || count > maxLeafFaces) maxLeafFaces = count;
+    if (depths.size() <= depth) depths.resize(depth + 1, 0);
+    depths[depth]++;
+    leaves++;
+    leafFaces += count;
+}
+
+void TreeStatistics::Finish(unsigned int inputFaces, unsigned int inner,
+                            float relations) {
+    if (leaves) leafFaces /= leaves;
+    if (inner) balance = relations / inner;
+    splitFaces = (faces > inputFaces) ? faces - inputFaces : 0;
+    memory += faces * face_entry + splitFaces * sizeof(Face);
+}
+
+/**
+ * Collect statistics of a BSP tree.
+ * Faces in the span set of inner nodes are counted as stored faces,
+ * but only leaves count in the faces per leaf. Split faces are
+ * counted against the face count the root was built from. Nodes of a
+ * lazy build that are not yet refined are counted as leaves holding
+ * their pending faces, collecting never refines the tree.
+ *
+ * @param root Root of the tree.
+ */
+void TreeStatistics::Collect(BSPNode* root) {
+    Clear();
+    if (!root) return;
+    unsigned int inner = 0;
+    float relations = 0;
+    std::vector<pair<BSPNode*, unsigned int> > stack;
+    stack.push_back(make_pair(root, 0u));
+    while (!stack.empty()) {
+        BSPNode* node = stack.back().first;
+        unsigned int depth = stack.back().second;
+        stack.pop_back();
+        nodes++;
+        // a pending node holds its faces unbuilt, count it as a leaf
+        // without refining it
+        if (!node->IsRefined()) {
+            unsigned int count = node->GetFaceCount();
+            faces += count;
+            memory += sizeof(BSPNode) + sizeof(FaceSet);
+            AddLeaf(depth, count);
+            continue;
+        }
+        unsigned int count = (node->GetSpan()) ? node->GetSpan()->Size() : 0;
+        faces += count;
+        memory += sizeof(BSPNode) + sizeof(GeometryNode) + sizeof(FaceSet);
+        BSPNode* front = node->GetFront();
+        BSPNode* back = node->GetBack();
+        if (!front && !back) {
+            AddLeaf(depth, count);
+            continue;
+        }
+        inner++;
+        relations += Relation((front) ? front->GetFaceCount() : 0,
+                              (back) ? back->GetFaceCount() : 0);
+        if (back) stack.push_back(make_pair(back, depth + 1));
+        if (front) stack.push_back(make_pair(front, depth + 1));
+    }
+    Finish(root->GetFaceCount(), inner, relations);
+}
+
+/**
+ * Collect statistics of a quad tree.
+ * Quad nodes do not know the number of faces they were built from,
+ * so split faces are only counted if \a inputFaces is given. The
+ * balance is the relation of the smallest to the largest child sub
+ * tree in face count.
+ *
+ * @param root Root of the tree.
+ * @param inputFaces Face count the tree was built from, or zero.
+ */
+void TreeStatistics::Collect(QuadNode* root, unsigned int inputFaces) {
+    Clear();
+    if (!root) return;
+
+    // pre-order list of nodes with their parents
+    std::vector<QuadNode*> order;
+    std::vector<int> parents;
+    std::vector<unsigned int> counts;
+    std::vector<pair<QuadNode*, pair<int, unsigned int> > > stack;
+    stack.push_back(make_pair(root, make_pair(-1, 0u)));
+    while (!stack.empty()) {
+        QuadNode* node = stack.back().first;
+        int parent = stack.back().second.first;
+        unsigned int depth = stack.back().second.second;
+        stack.pop_back();
+        int id = order.size();
+        order.push_back(node);
+        parents.push_back(parent);
+        nodes++;
+        memory += sizeof(QuadNode);
+
+        unsigned int count = 0;
+        for (list<ISceneNode*>::iterator itr = node->subNodes.begin();
+             itr != node->subNodes.end(); itr++) {
+            GeometryNode* geom = dynamic_cast<GeometryNode*>(*itr);
+            if (!geom) continue;
+            count += geom->GetFaceSet()->Size();
+            memory += sizeof(GeometryNode) + sizeof(FaceSet);
+        }
+        counts.push_back(count);
+        faces += count;
+
+        QuadNode* children[4] = { node->GetTopLeft(), node->GetTopRight(),
+                                  node->GetBottomLeft(), node->GetBottomRight() };
+        bool leaf = true;
+        for (int i = 3; i >= 0; i--)
+            if (children[i]) {
+                stack.push_back(make_pair(children[i], make_pair(id, depth + 1)));
+                leaf = false;
+            }
+        if (leaf) AddLeaf(depth, count);
+    }
+
+    // sum the sub tree face counts bottom up and relate the children
+    std::vector<unsigned int> lo(order.size(), ~0u), hi(order.size(), 0);
+    for (int i = order.size() - 1; i > 0; i--) {
+        int p = parents[i];
+        if (counts[i] < lo[p]) lo[p] = counts[i];
+        if (counts[i] > hi[p]) hi[p] = counts[i];
+        counts[p] += counts[i];
+    }
+    unsigned int inner = 0;
+    float relations = 0;
+    for (unsigned int i = 0; i < order.size(); i++) {
+        if (hi[i] == 0) continue;
+        inner++;
+        relations += (float)lo[i] / hi[i];
+    }
+    Finish((inputFaces) ? inputFaces : faces, inner, relations);
+}
+
+/**
+ * Get the statistics as a multi line text for logging.
+ *
+ * @return Statistics text.
+ */
+std::string TreeStatistics::ToString() const {
+    std::ostringstream out;
+    out << "Nodes: " << nodes << " (" << leaves << " leaves)\n"
+        << "Depth: " << minDepth << " - " << maxDepth << "\n"
+        << "Leaves per depth:";
+    for (unsigned int i = 0; i < depths.size(); i++)
+        out << " " << depths[i];
+    out << "\n"
+        << "Faces: " << faces << " (" << splitFaces << " from splits)\n"
+        << "Faces per leaf: " << minLeafFaces << " - " << maxLeafFaces
+        << " (average " << leafFaces << ")\n"
+        << "Balance: " << balance << "\n"
+        << "Memory: " << memory / 1024 << " KB\n"
+        << "Build time: " << timings.total / 1000 << " ms (divider "
+        << timings.divider / 1000 << " ms, partition "
+        << timings.partition / 1000 << " ms, allocation "
+        << timings.allocation / 1000 << " ms)";
+    return out.str();
+}
+
+} // NS Scene
+} // NS OpenEngine
@@ -0,0 +1,94 @@
+// Acceleration structure statistics.
+// -------------------------------------------------------------------
+// Copyright (C) 2007 OpenEngine.dk (See AUTHORS)
+//
+// This program is free software; It is covered by the GNU General
+// Public License version 2 or any later version.
+// See the GNU General Public License for more details (see LICENSE).
+//--------------------------------------------------------------------
+
+#ifndef _OE_TREE_STATISTICS_H_
+#define _OE_TREE_STATISTICS_H_
+
+#include <string>
+#include <vector>
+#include <cstddef>
+
+namespace OpenEngine {
+namespace Scene {
+
+class BSPNode;
+class QuadNode;
+
+/**
+ * Time spent in the phases of a tree build, in microseconds.
+ * Parallel builds sum the time of all threads, so the phases may add
+ * up to more than the total.
+ *
+ * @class BuildTimings TreeStatistics.h Scene/TreeStatistics.h
+ */
+struct BuildTimings {
+    unsigned long long divider;     //!< searching dividing planes
+    unsigned long long partition;   //!< partitioning and splitting faces
+    unsigned long long allocation;  //!< allocating nodes and face sets
+    unsigned long long total;       //!< wall clock time of the build
+
+    BuildTimings() { Clear(); }
+    void Clear() { divider = partition = allocation = total = 0; }
+    void Add(const BuildTimings& t) {
+        divider += t.divider;
+        partition += t.partition;
+        allocation += t.allocation;
+    }
+    static unsigned long long Now();
+};
+
+/**
+ * Quality and size statistics of a BSP or quad tree.
+ *
+ * The statistics are collected from the tree in one iterative pass,
+ * so they can be logged when a level is loaded. Build timings are not
+ * part of the tree and must be taken from the transformer.
+ *
+ * @code
+ * TreeStatistics stats;
+ * stats.Collect(root);
+ * stats.timings = bspt.GetBuildTimings();
+ * logger.info << stats.ToString() << logger.end;
+ * @endcode
+ *
+ * @class TreeStatistics TreeStatistics.h Scene/TreeStatistics.h
+ */
+class TreeStatistics {
+public:
+    unsigned int nodes;             //!< tree nodes
+    unsigned int leaves;            //!< nodes without child nodes
+    unsigned int minDepth;          //!< depth of the most shallow leaf
+    unsigned int maxDepth;          //!< depth of the deepest leaf
+    std::vector<unsigned int> depths; //!< leaf count per depth
+    unsigned int faces;             //!< faces stored in the tree
+    unsigned int splitFaces;        //!< faces added by splitting
+    unsigned int minLeafFaces;      //!< fewest faces in a leaf
+    unsigned int maxLeafFaces;      //!< most faces in a leaf
+    float leafFaces;                //!< average faces per leaf
+    float balance;                  //!< average relation of sibling sizes
+    size_t memory;                  //!< estimated bytes used by the tree
+    BuildTimings timings;           //!< build timings if assigned
+
+    TreeStatistics();
+
+    void Clear();
+    void Collect(BSPNode* root);
+    void Collect(QuadNode* root, unsigned int inputFaces = 0);
+
+    std::string ToString() const;
+
+private:
+    void AddLeaf(unsigned int depth, unsigned int count);
+    void Finish(unsigned int inputFaces, unsigned int inner, float relations);
+};
+
+} // NS Scene
+} // NS OpenEngine
+
+#endif // _OE_TREE_STATISTICS_H_
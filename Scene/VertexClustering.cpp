@@ -0,0 +1,130 @@
+// Mesh simplification by vertex clustering.
+// -------------------------------------------------------------------
+// Copyright (C) 2007 OpenEngine.dk (See AUTHORS)
+//
+// This program is free software; It is covered by the GNU General
+// Public License version 2 or any later version.
+// See the GNU General Public License for more details (see LICENSE).
+//--------------------------------------------------------------------
+
+#include <Scene/VertexClustering.h>
+#include <algorithm>
+#include <cmath>
+#include <map>
+#include <set>
+#include <vector>
+
+namespace OpenEngine {
+namespace Scene {
+
+// merged vertices of a cell
+struct VertexCluster {
+    Vector<3,float> position;
+    Vector<3,float> normal;
+    unsigned int count;
+    VertexCluster() : position(0,0,0), normal(0,0,0), count(0) {}
+};
+
+// faces by their sorted cluster indices
+struct ClusterFace {
+    unsigned int c[3];
+    bool operator<(const ClusterFace& f) const {
+        if (c[0] != f.c[0]) return c[0] < f.c[0];
+        if (c[1] != f.c[1]) return c[1] < f.c[1];
+        return c[2] < f.c[2];
+    }
+};
+
+/**
+ * Simplify faces by vertex clustering.
+ *
+ * The representative of a cell is the average position and normal of
+ * its vertices. The simplified faces keep the material, texture
+ * coordinates and colors of the faces they replace.
+ *
+ * @param faces Faces to simplify.
+ * @param box Box containing the faces.
+ * @param resolution Cells along the longest axis of the box.
+ * @param[out] error Bound of the distance any vertex has moved.
+ * @return New face set of the simplified faces, owned by the caller.
+ */
+FaceSet* VertexClustering::Simplify(FaceSet& faces, const Box& box,
+                                    unsigned int resolution, float& error) {
+    Vector<3,float> center = box.GetCenter();
+    Vector<3,float> corner = box.GetCorner();
+    float lo[3], extent = 0;
+    for (unsigned int a = 0; a < 3; a++) {
+        float c = std::fabs(corner[a]);
+        lo[a] = center[a] - c;
+        extent = std::max(extent, 2 * c);
+    }
+    if (resolution == 0) resolution = 1;
+    float cell = extent / resolution;
+    error = cell * std::sqrt(3.0f);
+    float scale = (cell > 0) ? 1 / cell : 0;
+
+    // assign the vertices to cells
+    std::map<unsigned long long, unsigned int> cells;
+    std::vector<VertexCluster> clusters;
+    std::vector<unsigned int> ids;
+    ids.reserve(faces.Size() * 3);
+    for (FaceList::iterator itr = faces.begin(); itr != faces.end(); itr++) {
+        Face& f = **itr;
+        for (unsigned int v = 0; v < 3; v++) {
+            unsigned long long key = 0;
+            for (unsigned int a = 0; a < 3; a++) {
+                float x = (f.vert[v][a] - lo[a]) * scale;
+                unsigned int i = (x > 0) ? (unsigned int)x : 0;
+                if (i >= resolution) i = resolution - 1;
+                key = key * resolution + i;
+            }
+            std::map<unsigned long long, unsigned int>::iterator c = cells.find(key);
+            if (c == cells.end()) {
+                c = cells.insert(std::make_pair(key, (unsigned int)clusters.size())).first;
+                clusters.push_back(VertexCluster());
+            }
+            VertexCluster& cluster = clusters[c->second];
+            cluster.position = cluster.position + f.vert[v];
+            cluster.normal = cluster.normal + f.norm[v];
+            cluster.count++;
+            ids.push_back(c->second);
+        }
+    }
+    for (unsigned int i = 0; i < clusters.size(); i++) {
+        VertexCluster& cluster = clusters[i];
+        cluster.position = cluster.position * (1.0f / cluster.count);
+        float len = std::sqrt(cluster.normal * cluster.normal);
+        if (len > 0) cluster.normal = cluster.normal * (1 / len);
+    }
+
+    // emit the faces spanning three cells, once
+    FaceSet* result = new FaceSet();
+    std::set<ClusterFace> emitted;
+    unsigned int n = 0;
+    for (FaceList::iterator itr = faces.begin(); itr != faces.end(); itr++, n += 3) {
+        ClusterFace cf;
+        for (unsigned int v = 0; v < 3; v++) cf.c[v] = ids[n + v];
+        if (cf.c[0] == cf.c[1] || cf.c[1] == cf.c[2] || cf.c[0] == cf.c[2])
+            continue;
+        ClusterFace key = cf;
+        std::sort(key.c, key.c + 3);
+        if (!emitted.insert(key).second) continue;
+
+        Face& f = **itr;
+        FacePtr face(new Face(clusters[cf.c[0]].position,
+                              clusters[cf.c[1]].position,
+                              clusters[cf.c[2]].position));
+        for (unsigned int v = 0; v < 3; v++) {
+            face->norm[v] = clusters[cf.c[v]].normal;
+            face->texc[v] = f.texc[v];
+            face->colr[v] = f.colr[v];
+        }
+        face->CalcHardNorm();
+        face->mat = f.mat;
+        result->Add(face);
+    }
+    return result;
+}
+
+} // NS Scene
+} // NS OpenEngine
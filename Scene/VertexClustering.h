@@ -0,0 +1,46 @@
+// Mesh simplification by vertex clustering.
+// -------------------------------------------------------------------
+// Copyright (C) 2007 OpenEngine.dk (See AUTHORS)
+//
+// This program is free software; It is covered by the GNU General
+// Public License version 2 or any later version.
+// See the GNU General Public License for more details (see LICENSE).
+//--------------------------------------------------------------------
+
+#ifndef _OE_VERTEX_CLUSTERING_H_
+#define _OE_VERTEX_CLUSTERING_H_
+
+#include <Geometry/FaceSet.h>
+#include <Geometry/Box.h>
+
+namespace OpenEngine {
+namespace Scene {
+
+using namespace OpenEngine::Geometry;
+
+/**
+ * Mesh simplification by vertex clustering.
+ *
+ * The bounding box is divided in a grid of cubic cells and all
+ * vertices within a cell are merged to their average. Faces with two
+ * vertices in the same cell collapse and are dropped, as are
+ * duplicates of other faces. No vertex moves farther than the
+ * diagonal of a cell, which bounds the geometric error.
+ *
+ * @code
+ * float error;
+ * FaceSet* proxy = VertexClustering::Simplify(faces, box, 16, error);
+ * @endcode
+ *
+ * @class VertexClustering VertexClustering.h Scene/VertexClustering.h
+ */
+class VertexClustering {
+public:
+    static FaceSet* Simplify(FaceSet& faces, const Box& box,
+                             unsigned int resolution, float& error);
+};
+
+} // NS Scene
+} // NS OpenEngine
+
+#endif // _OE_VERTEX_CLUSTERING_H_
@@ -1,4 +1,5 @@
 OE_ADD_SCENE_NODES(Extensions_AccelerationStructures
   Scene/QuadNode
+  Scene/OctNode
   Scene/BSPNode
 )